@@ -0,0 +1,118 @@
+/*
+ * Whole-assembler benchmark: assembles a source file (from gencorpus, say)
+ * in memory and writes the image out, timing each phase, and prints one row
+ * of throughput and peak memory for it. Each size runs as a process of its
+ * own, so that peak RSS is that size's alone.
+ *
+ * Usage: asmbench -H
+ *        asmbench [-r REPEATS] [-o OUTFILE] file
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/resource.h>
+
+#include "../src/libjas.h"
+#include "../src/Source.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void header(void) {
+    printf("%10s %10s %9s %9s %9s %9s %9s %9s\n", "size", "lines", "lex ms",
+           "asm ms", "write ms", "MB/s", "Mlines/s", "RSS MB");
+}
+
+/* a byte count the way gencorpus takes them */
+static void printSize(size_t len) {
+    char buf[32];
+
+    if (len >= 1 << 30) sprintf(buf, "%.1fG", len / (double) (1 << 30));
+    else if (len >= 1 << 20) sprintf(buf, "%.1fM", len / (double) (1 << 20));
+    else if (len >= 1 << 10) sprintf(buf, "%.1fK", len / (double) (1 << 10));
+    else sprintf(buf, "%ld", (long) len);
+    printf("%10s", buf);
+}
+
+int main(int argc, char * argv[]) {
+    const char * outname = "asmbench.out";
+    int repeats = 3, opt, r;
+    double lex_best = 0, asm_best = 0, write_best = 0, t0, t1, total;
+    JasContext * ctx = jas_context_new();
+    struct Source src;
+    const char * image;
+    size_t size;
+    long lines = 0;
+    struct rusage ru;
+    FILE * in, * out;
+
+    while ((opt = getopt(argc, argv, "Hr:o:")) != -1) {
+        switch (opt) {
+            case 'H': header(); return 0;
+            case 'r': repeats = atoi(optarg); break;
+            case 'o': outname = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s -H | [-r REPEATS] [-o OUTFILE] "
+                        "file\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (ctx == NULL || optind >= argc) return 1;
+    if ((in = fopen(argv[optind], "rb")) == NULL || loadSource(&src, in)) {
+        fprintf(stderr, "asmbench: cannot read `%s'\n", argv[optind]);
+        return 1;
+    }
+    fclose(in);
+    ctx->filename = argv[optind];
+
+    for (r = 0; r < repeats; r++) {
+        /* lexing alone */
+        jas_context_reset(ctx);
+        lex_init(ctx, src.data, src.len);
+        t0 = now();
+        while (next_tok(ctx).type != TOK_EOF) ;
+        t1 = now();
+        lines = ctx->lex.line;
+        if (r == 0 || t1 - t0 < lex_best) lex_best = t1 - t0;
+
+        /* lexing, parsing, encoding and resolving labels */
+        t0 = now();
+        if (jas_assemble_buffer(ctx, src.data, src.len, &image, &size)) {
+            fprintf(stderr, "asmbench: `%s' does not assemble\n",
+                    argv[optind]);
+            return 1;
+        }
+        t1 = now();
+        if (r == 0 || t1 - t0 < asm_best) asm_best = t1 - t0;
+
+        /* writing the image */
+        if ((out = fopen(outname, "wb")) == NULL) return 1;
+        t0 = now();
+        if (fwrite(image, 1, size, out) != size || fflush(out)) return 1;
+        t1 = now();
+        fclose(out);
+        if (r == 0 || t1 - t0 < write_best) write_best = t1 - t0;
+    }
+    remove(outname);
+
+    getrusage(RUSAGE_SELF, &ru);
+    total = asm_best + write_best;
+
+    printSize(src.len);
+    printf(" %10ld %9.1f %9.1f %9.1f %9.1f %9.2f %9.1f\n", lines,
+           lex_best * 1e3, asm_best * 1e3, write_best * 1e3,
+           src.len / 1e6 / total, lines / 1e6 / total, ru.ru_maxrss / 1024.0);
+
+    freeSource(&src);
+    jas_context_free(ctx);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Encoder benchmark: builds the same program twice, once by printing assembly
+ * text and assembling it with jas_assemble_buffer(), once straight through
+ * the structured jas_emit() API, and checks that the images match.
+ *
+ * Usage: encbench [-n INSTRUCTIONS] [-r REPEATS]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../src/libjas.h"
+
+/* a label every this many instructions */
+#define BLOCK 8
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the text a code generator would print, into a buffer that grows */
+static char * print_program(long n, size_t * len) {
+    size_t cap = 64 * n + 64, used = 0;
+    char * text = malloc(cap);
+    long i;
+
+    for (i = 0; i < n; i += BLOCK) {
+        used += sprintf(text + used,
+                        "L%ld:\n"
+                        "  add 5, r1\n"
+                        "  mov [r2 + 8], r3\n"
+                        "  sub 1000, r4\n"
+                        "  cmp r1, L%ld\n"
+                        "  jne L%ld\n"
+                        "  xor r5, r5\n"
+                        "  inc r6\n"
+                        "  mov [r7], r8\n",
+                        i / BLOCK, i / BLOCK + 1, i / BLOCK);
+    }
+    used += sprintf(text + used, "L%ld:\n  nop\n", i / BLOCK);
+
+    *len = used;
+    return text;
+}
+
+/* the same program through the structured API */
+static int emit_program(JasContext * ctx, long n,
+                        const char ** image, size_t * size) {
+    int add = jas_mnemonic("add"), mov = jas_mnemonic("mov");
+    int sub = jas_mnemonic("sub"), cmp = jas_mnemonic("cmp");
+    int jne = jas_mnemonic("jne"), xor = jas_mnemonic("xor");
+    int inc = jas_mnemonic("inc"), nop = jas_mnemonic("nop");
+    char here[32], next[32];
+    int hlen, nlen;
+    long i;
+
+    jas_begin(ctx);
+    for (i = 0; i < n; i += BLOCK) {
+        hlen = sprintf(here, "L%ld", i / BLOCK);
+        nlen = sprintf(next, "L%ld", i / BLOCK + 1);
+
+        jas_label(ctx, here, hlen);
+        jas_emit(ctx, add, jas_imm(5), jas_reg("r1"), OPSZ_INDET);
+        jas_emit(ctx, mov, jas_ind_off("r2", 8), jas_reg("r3"), OPSZ_INDET);
+        jas_emit(ctx, sub, jas_imm(1000), jas_reg("r4"), OPSZ_INDET);
+        jas_emit(ctx, cmp, jas_reg("r1"), jas_ref(ctx, next, nlen),
+                 OPSZ_INDET);
+        jas_emit(ctx, jne, jas_ref(ctx, here, hlen), jas_none(), OPSZ_INDET);
+        jas_emit(ctx, xor, jas_reg("r5"), jas_reg("r5"), OPSZ_INDET);
+        jas_emit(ctx, inc, jas_reg("r6"), jas_none(), OPSZ_INDET);
+        jas_emit(ctx, mov, jas_ind("r7"), jas_reg("r8"), OPSZ_INDET);
+    }
+    hlen = sprintf(here, "L%ld", i / BLOCK);
+    jas_label(ctx, here, hlen);
+    jas_emit(ctx, nop, jas_none(), jas_none(), OPSZ_INDET);
+
+    return jas_end(ctx, image, size);
+}
+
+int main(int argc, char * argv[]) {
+    long n = 1000000;
+    int repeats = 5, opt, r;
+    double print_best = 0, text_best = 0, api_best = 0, t0, t1, t2;
+    JasContext * text_ctx = jas_context_new();
+    JasContext * api_ctx = jas_context_new();
+    const char * text_image = NULL, * api_image = NULL;
+    size_t text_size = 0, api_size = 0, len = 0;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+            case 'n': n = strtol(optarg, NULL, 10); break;
+            case 'r': repeats = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n INSTRUCTIONS] [-r REPEATS]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    if (text_ctx == NULL || api_ctx == NULL) return 1;
+    n = (n + BLOCK - 1) / BLOCK * BLOCK;
+
+    for (r = 0; r < repeats; r++) {
+        char * text;
+
+        t0 = now();
+        text = print_program(n, &len);
+        t1 = now();
+        if (jas_assemble_buffer(text_ctx, text, len, &text_image, &text_size))
+            return 1;
+        t2 = now();
+        free(text);
+
+        if (r == 0 || t1 - t0 < print_best) print_best = t1 - t0;
+        if (r == 0 || t2 - t1 < text_best) text_best = t2 - t1;
+
+        t0 = now();
+        if (emit_program(api_ctx, n, &api_image, &api_size)) return 1;
+        t1 = now();
+
+        if (r == 0 || t1 - t0 < api_best) api_best = t1 - t0;
+    }
+
+    if (text_size != api_size || memcmp(text_image, api_image, api_size)) {
+        fprintf(stderr, "encbench: images differ\n");
+        return 1;
+    }
+
+    printf("%s: %ld instructions, %.1f MB of text, %.1f MB image\n",
+           argv[0], n + 1, len / 1e6, api_size / 1e6);
+    printf("  print + assemble  %7.1f Minstr/s  "
+           "(print %.3fs, assemble %.3fs)\n",
+           (n + 1) / 1e6 / (print_best + text_best), print_best, text_best);
+    printf("  structured API    %7.1f Minstr/s  (%.3fs)\n",
+           (n + 1) / 1e6 / api_best, api_best);
+
+    jas_context_free(text_ctx);
+    jas_context_free(api_ctx);
+    return 0;
+}
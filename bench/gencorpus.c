@@ -0,0 +1,221 @@
+/*
+ * Synthetic corpus generator: writes a valid .jas source of about the given
+ * size to stdout, for benchmarking the assembler at any scale. Instructions
+ * are drawn from every entry of the ISA description (src/Isa.def), with
+ * operands of every form its prototype accepts, at both sizes.
+ *
+ * Usage: gencorpus [-s SIZE] [-l N] [-f PCT] [-r PCT] [-d PCT] [-c PCT]
+ *                  [-S SEED]
+ *
+ *     -s SIZE  bytes of source, with an optional K, M or G suffix (1M)
+ *     -l N     a label every N instructions on average (8)
+ *     -r PCT   constant operands that are label references (20)
+ *     -f PCT   label references to labels not defined yet (30)
+ *     -d PCT   statements that are db/dw/ds data (10)
+ *     -c PCT   lines indented and commented like compiler output (25)
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "../src/Instruction.h"
+
+/* what a prototype accepts as an operand, as in mkisa */
+enum { NONE, ANY, REG_IND, CONST };
+
+struct Instr {
+    const char * name;
+    int op[2];
+};
+
+static const int protos[ISA_TYPES][2] = {
+#define PROTO(type, op1, op2) {op1, op2},
+#define INSTR(name, opcode, type)
+#include "../src/Isa.def"
+#undef PROTO
+#undef INSTR
+};
+
+static const struct Instr instrs[] = {
+#define PROTO(type, op1, op2)
+#define INSTR(name, opcode, type) {#name, {protos[IT_##type][0], \
+                                           protos[IT_##type][1]}},
+#include "../src/Isa.def"
+#undef PROTO
+#undef INSTR
+};
+
+#define NUM_INSTRS (int) (sizeof(instrs) / sizeof(instrs[0]))
+
+/* how far ahead a forward reference reaches, in labels */
+#define FORWARD_REACH 4
+
+static const char * const comments[] = {
+    "spill slot 12, live range 40..88",
+    "loop header",
+    "generated from node 0x1234",
+    "bounds check elided",
+    "inlined from memcpy",
+    "tail call"
+};
+
+static unsigned long seed = 1;
+
+/* settings */
+static int labelEvery = 8, refPct = 20, forwardPct = 30, dataPct = 10,
+           commentPct = 25;
+
+/* labels defined so far, and the furthest one referred to */
+static long labels = 0, furthest = -1;
+
+static unsigned next(unsigned range) {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (unsigned) (seed >> 33) % range;
+}
+
+static int chance(int pct) {
+    return (int) next(100) < pct;
+}
+
+static long parseSize(const char * s) {
+    char * end;
+    long size = strtol(s, &end, 10);
+
+    switch (*end) {
+        case 'k': case 'K': return size << 10;
+        case 'm': case 'M': return size << 20;
+        case 'g': case 'G': return size << 30;
+    }
+    return size;
+}
+
+static long printReg(int isShort) {
+    if (isShort) return printf("r%u%c", next(16), 'a' + next(4));
+    return printf("r%u", next(16));
+}
+
+/* a constant, or a reference to a label behind or ahead */
+static long printConst(int isShort) {
+    long label;
+
+    if (chance(refPct)) {
+        if (labels == 0 || chance(forwardPct)) {
+            label = labels + next(FORWARD_REACH);
+            if (label > furthest) furthest = label;
+        } else {
+            label = labels - 1 - next(labels < 64 ? labels : 64);
+        }
+        return printf("L%ld", label);
+    }
+
+    if (isShort) return printf("%d", (int) next(256) - 128);
+    return printf("%d", (int) next(1u << 20) - (1 << 19));
+}
+
+static long printOperand(int spec, int isShort) {
+    long n = 0;
+    int form = next(spec == ANY ? 4 : 3);
+
+    if (spec == CONST || form == 3) return printConst(isShort);
+    if (form == 0) return printReg(isShort);
+
+    n += printf("[");
+    n += printReg(isShort);
+    if (form == 2) {
+        int offset = (int) next(64) - 32;
+        n += printf(offset < 0 ? " - %d" : " + %d", offset < 0 ? -offset
+                                                               : offset);
+    }
+    return n + printf("]");
+}
+
+static long printInstruction(void) {
+    const struct Instr * in = &instrs[next(NUM_INSTRS)];
+    int isShort = next(2);
+    const char * c;
+    long n = 0;
+
+    for (c = in->name; *c; c++, n++) putchar(tolower((unsigned char) *c));
+
+    if (in->op[0] != NONE) {
+        n += printf(" ");
+        n += printOperand(in->op[0], isShort);
+    }
+    if (in->op[1] != NONE) {
+        n += printf(", ");
+        n += printOperand(in->op[1], isShort);
+    }
+    return n;
+}
+
+static long printData(void) {
+    long n = 0;
+    int i, count;
+
+    switch (next(3)) {
+        case 0:
+            count = 1 + next(8);
+            n += printf("db ");
+            for (i = 0; i < count; i++)
+                n += printf("%s%d", i ? ", " : "", (int) next(256) - 128);
+            break;
+        case 1:
+            count = 1 + next(4);
+            n += printf("dw ");
+            for (i = 0; i < count; i++)
+                n += printf("%s%d", i ? ", " : "", (int) next(1u << 30));
+            break;
+        default:
+            n += printf("ds \"%s\\n\"", comments[next(6)]);
+            break;
+    }
+    return n;
+}
+
+/* one line: maybe a label, then a statement, dressed up or not */
+static long printLine(void) {
+    int dressed = chance(commentPct);
+    long n = 0;
+
+    if (next(labelEvery) == 0) n += printf("L%ld:\n", labels++);
+
+    if (dressed && next(8) == 0) n += printf("\n");
+    n += printf(dressed ? "                        " : "    ");
+    n += chance(dataPct) ? printData() : printInstruction();
+    if (dressed) n += printf("    ; %s", comments[next(6)]);
+    return n + printf("\n");
+}
+
+int main(int argc, char * argv[]) {
+    long size = 1 << 20, written = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:l:r:f:d:c:S:")) != -1) {
+        switch (opt) {
+            case 's': size = parseSize(optarg); break;
+            case 'l': labelEvery = atoi(optarg); break;
+            case 'r': refPct = atoi(optarg); break;
+            case 'f': forwardPct = atoi(optarg); break;
+            case 'd': dataPct = atoi(optarg); break;
+            case 'c': commentPct = atoi(optarg); break;
+            case 'S': seed = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-s SIZE] [-l N] [-f PCT] "
+                        "[-r PCT] [-d PCT] [-c PCT] [-S SEED]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (labelEvery < 1) labelEvery = 1;
+
+    while (written < size) written += printLine();
+
+    /* define whatever was referred to ahead */
+    while (labels <= furthest) printf("L%ld:\n", labels++);
+    printf("    hlt\n");
+
+    return ferror(stdout) ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Retained statement benchmark: assembles the same program encoding each
+ * statement as it is parsed, then retaining every statement and encoding
+ * them all afterwards (see src/Statements.h), and checks that the images
+ * match. Reports the time and arena memory each way takes.
+ *
+ * Usage: irbench [-n INSTRUCTIONS] [-r REPEATS]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../src/libjas.h"
+
+/* a label every this many instructions */
+#define BLOCK 8
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* a program with labels both ways and a data segment in every block */
+static char * print_program(long n, size_t * len) {
+    size_t cap = 80 * n + 64, used = 0;
+    char * text = malloc(cap);
+    long i;
+
+    for (i = 0; i < n; i += BLOCK) {
+        used += sprintf(text + used,
+                        "L%ld:\n"
+                        "  add 5, r1\n"
+                        "  mov [r2 + 8], r3\n"
+                        "  sub 1000, r4\n"
+                        "  cmp r1, L%ld\n"
+                        "  jne L%ld\n"
+                        "  xor r5, r5\n"
+                        "  inc r6\n"
+                        "  mov [r7], r8\n"
+                        "  dw 1, 2, 3\n",
+                        i / BLOCK, i / BLOCK + 1, i / BLOCK);
+    }
+    used += sprintf(text + used, "L%ld:\n  nop\n", i / BLOCK);
+
+    *len = used;
+    return text;
+}
+
+/* best time of `repeats` assemblies of `text`, the image left in ctx */
+static double run(JasContext * ctx, const char * text, size_t len,
+                  int repeats, const char ** image, size_t * size) {
+    double best = 0, t0, t1;
+    int r;
+
+    for (r = 0; r < repeats; r++) {
+        t0 = now();
+        if (jas_assemble_buffer(ctx, text, len, image, size)) return -1;
+        t1 = now();
+
+        if (r == 0 || t1 - t0 < best) best = t1 - t0;
+    }
+    return best;
+}
+
+int main(int argc, char * argv[]) {
+    long n = 1000000, stmts;
+    int repeats = 5, opt;
+    double direct_best, retain_best;
+    JasContext * direct = jas_context_new();
+    JasContext * retain = jas_context_new();
+    const char * direct_image = NULL, * retain_image = NULL;
+    size_t direct_size = 0, retain_size = 0, len = 0;
+    char * text;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+            case 'n': n = strtol(optarg, NULL, 10); break;
+            case 'r': repeats = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n INSTRUCTIONS] [-r REPEATS]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    if (direct == NULL || retain == NULL) return 1;
+    n = (n + BLOCK - 1) / BLOCK * BLOCK;
+    retain->retain = 1;
+
+    text = print_program(n, &len);
+    direct_best = run(direct, text, len, repeats, &direct_image, &direct_size);
+    retain_best = run(retain, text, len, repeats, &retain_image, &retain_size);
+    if (direct_best < 0 || retain_best < 0) return 1;
+
+    if (direct_size != retain_size
+            || memcmp(direct_image, retain_image, direct_size)) {
+        fprintf(stderr, "irbench: images differ\n");
+        return 1;
+    }
+
+    stmts = retain->stmts.num;
+    printf("%s: %ld statements, %.1f MB of text, %.1f MB image\n",
+           argv[0], stmts, len / 1e6, direct_size / 1e6);
+    printf("  encode while parsing  %7.1f Mstmt/s  (%.3fs, "
+           "arena peak %.1f MB)\n",
+           stmts / 1e6 / direct_best, direct_best,
+           direct->arena.peak / 1e6);
+    printf("  retain, then encode   %7.1f Mstmt/s  (%.3fs, "
+           "arena peak %.1f MB)\n",
+           stmts / 1e6 / retain_best, retain_best,
+           retain->arena.peak / 1e6);
+    printf("  %lu bytes per statement, %.1f MB of arrays for %ld slots\n",
+           (unsigned long) STATEMENT_BYTES,
+           retain->stmts.cap * STATEMENT_BYTES / 1e6, retain->stmts.cap);
+
+    free(text);
+    jas_context_free(direct);
+    jas_context_free(retain);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Lexer microbenchmark: tokenizes a corpus built by repeating the given
+ * source files until it reaches a target size, and reports throughput.
+ *
+ * Usage: lexbench [-s MB] [-r REPEATS] file...
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../src/libjas.h"
+#include "../src/scan.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* append the whole of `path` to buf */
+static size_t slurp(const char * path, char ** buf, size_t len, size_t * cap) {
+    FILE * f = fopen(path, "rb");
+    size_t got;
+
+    if (f == NULL) {
+        fprintf(stderr, "lexbench: cannot open `%s'\n", path);
+        exit(1);
+    }
+
+    do {
+        if (len == *cap) {
+            *cap = *cap ? *cap * 2 : 65536;
+            *buf = realloc(*buf, *cap);
+        }
+        got = fread(*buf + len, 1, *cap - len, f);
+        len += got;
+    } while (got > 0);
+
+    fclose(f);
+    return len;
+}
+
+/*
+ * Walk the corpus with only the run scanners, the part of next_tok() that
+ * the SIMD kernels speed up. Returns the number of runs found.
+ */
+static long scan_only(const char * p, const char * end) {
+    long runs = 0;
+
+    while (p < end) {
+        unsigned char c = *p;
+        if (char_class[c] & CC_SPACE)       p = scan_space(p + 1, end);
+        else if (char_class[c] & CC_IDSTART) p = scan_ident(p + 1, end);
+        else if (c == ';')                   p = scan_eol(p + 1, end);
+        else                                 p++;
+        runs++;
+    }
+
+    return runs;
+}
+
+int main(int argc, char * argv[]) {
+    size_t target = 64, seedlen = 0, seedcap = 0, len = 0;
+    int repeats = 5, opt, r;
+    char * seed = NULL, * corpus;
+    double best = 0, scanbest = 0;
+    long ntok = 0, lines = 0, runs = 0;
+    JasContext * ctx = jas_context_new();
+
+    while ((opt = getopt(argc, argv, "s:r:")) != -1) {
+        switch (opt) {
+            case 's': target = strtoul(optarg, NULL, 10); break;
+            case 'r': repeats = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-s MB] [-r REPEATS] file...\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    for (; optind < argc; optind++)
+        seedlen = slurp(argv[optind], &seed, seedlen, &seedcap);
+
+    if (ctx == NULL) return 1;
+    ctx->filename = "(bench)";
+
+    if (seedlen == 0) {
+        fprintf(stderr, "lexbench: empty corpus\n");
+        return 1;
+    }
+
+    /* scale the seed up to the target size */
+    target *= 1024 * 1024;
+    corpus = malloc(target + seedlen);
+    while (len < target) {
+        memcpy(corpus + len, seed, seedlen);
+        len += seedlen;
+    }
+
+    /* errors in the seed would repeat per copy, keep the run quiet */
+    if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+
+    for (r = 0; r < repeats; r++) {
+        Token tok;
+        double t0, dt;
+
+        ntok = 0;
+        jas_context_reset(ctx);
+        lex_init(ctx, corpus, len);
+
+        t0 = now();
+        while ((tok = next_tok(ctx)).type != TOK_EOF) ntok++;
+        dt = now() - t0;
+
+        if (r == 0 || dt < best) best = dt;
+        lines = ctx->lex.line;
+
+        t0 = now();
+        runs = scan_only(corpus, corpus + len);
+        dt = now() - t0;
+
+        if (r == 0 || dt < scanbest) scanbest = dt;
+    }
+
+    printf("%s: %.1f MB, %ld lines, %ld tokens, %ld runs\n",
+           argv[0], len / 1e6, lines, ntok, runs);
+    printf("  next_tok  %8.1f MB/s  %6.1f Mtok/s\n",
+           len / 1e6 / best, ntok / 1e6 / best);
+    printf("  scan only %8.1f MB/s\n", len / 1e6 / scanbest);
+
+    jas_context_free(ctx);
+    free(corpus);
+    free(seed);
+    return 0;
+}
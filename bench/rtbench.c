@@ -0,0 +1,257 @@
+/*
+ * Round-trip benchmark: assembles a large random program, disassembles the
+ * image (see src/Disasm.h), assembles the result again and checks that the
+ * two images are the same bytes. Reports how fast instructions decode, on
+ * their own and printed as source, and how fast the code index (see
+ * src/CodeIndex.h) finds and decodes instructions picked at random.
+ *
+ * The program is code only, every instruction type with every operand form
+ * at both sizes, so anything that comes back as data is a failure. It keeps
+ * clear of the encodings the disassembler cannot tell apart: no `[r0 + n]',
+ * no registers above 15 in [register + offset], no forced sizes.
+ *
+ * Usage: rtbench [-n INSTRUCTIONS] [-r REPEATS]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../src/libjas.h"
+#include "../src/Disasm.h"
+
+/* mnemonics by what their operands may be */
+static const char * const two_any[] = {
+    "add", "adc", "sub", "sbb", "cmp", "test", "and", "or", "xor", "mov"
+};
+static const char * const one_reg[] = {
+    "dec", "inc", "neg", "not", "pop", "rom", "roi", "rop", "rfl"
+};
+static const char * const one_any[] = {
+    "jmp", "je", "jne", "jl", "jle", "jg", "jge", "jlu", "jleu", "jgu",
+    "jgeu", "call", "lom", "loi", "lfl", "push"
+};
+static const char * const no_ops[] = {"nop", "ret", "hlt", "iret"};
+
+#define COUNT(a) (int) (sizeof(a) / sizeof((a)[0]))
+
+static unsigned seed = 1;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned next(unsigned range) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % range;
+}
+
+/* a register of the given size, r1.. r15 (or r0a.. r3c) if `indexed' */
+static int print_reg(char * out, int isShort, int indexed) {
+    if (isShort) {
+        int id = indexed ? 1 + next(15) : 1 + next(64);
+        return sprintf(out, "r%d%c", (id - 1) / 4, 'a' + (id - 1) % 4);
+    }
+    return sprintf(out, "r%d", indexed ? 1 + (int) next(15) : (int) next(16));
+}
+
+/* one operand: 0 register, 1 [register], 2 [register + offset], 3 constant */
+static int print_operand(char * out, int form, int isShort) {
+    int n = 0, offset;
+
+    switch (form) {
+        case 0:
+            return print_reg(out, isShort, 0);
+        case 1:
+            n += sprintf(out, "[");
+            n += print_reg(out + n, isShort, 0);
+            return n + sprintf(out + n, "]");
+        case 2:
+            /* in the offset field as often as not */
+            offset = next(2) ? (int) next(7) - 3 : (int) next(2001) - 1000;
+            if (!isShort) offset *= next(2) ? 4 : 1;
+            n += sprintf(out, "[");
+            n += print_reg(out + n, isShort, 1);
+            return n + sprintf(out + n, offset < 0 ? " - %d]" : " + %d]",
+                               offset < 0 ? -offset : offset);
+        default:
+            return sprintf(out, "%d", isShort ? (int) next(256) - 128
+                                              : (int) (next(1u << 24) << 7));
+    }
+}
+
+static char * print_program(long n, size_t * len) {
+    size_t cap = 48 * n + 64, used = 0;
+    char * text = malloc(cap);
+    long i;
+
+    if (text == NULL) return NULL;
+
+    for (i = 0; i < n; i++) {
+        int isShort = next(2), kind = next(8);
+        char * line = text + used;
+        int k = 0;
+
+        switch (kind) {
+            case 0: case 1: case 2:
+                k += sprintf(line, "  %s ", two_any[next(COUNT(two_any))]);
+                k += print_operand(line + k, next(4), isShort);
+                k += sprintf(line + k, ", ");
+                k += print_operand(line + k, next(3), isShort);
+                break;
+            case 3:
+                k += sprintf(line, "  %s ", one_reg[next(COUNT(one_reg))]);
+                k += print_operand(line + k, next(3), isShort);
+                break;
+            case 4:
+                k += sprintf(line, "  %s ", one_any[next(COUNT(one_any))]);
+                k += print_operand(line + k, next(4), isShort);
+                break;
+            case 5:
+                k += sprintf(line, "  %s ", next(2) ? "in" : "out");
+                k += print_operand(line + k, 3, isShort);
+                k += sprintf(line + k, ", ");
+                k += print_operand(line + k, next(3), isShort);
+                break;
+            case 6:
+                k += sprintf(line, "  xchg ");
+                k += print_operand(line + k, next(3), isShort);
+                k += sprintf(line + k, ", ");
+                k += print_operand(line + k, next(3), isShort);
+                break;
+            default:
+                if (next(2)) {
+                    k += sprintf(line, "  int %d", (int) next(256));
+                } else {
+                    k += sprintf(line, "  %s", no_ops[next(COUNT(no_ops))]);
+                }
+                break;
+        }
+        used += k + sprintf(line + k, "\n");
+    }
+
+    *len = used;
+    return text;
+}
+
+int main(int argc, char * argv[]) {
+    long n = 1000000, decoded = 0, i;
+    int repeats = 5, opt, r, k, more;
+    double decode_best = 0, print_best = 0, seek_best = 0, t0, t1;
+    JasContext * first = jas_context_new();
+    JasContext * second = jas_context_new();
+    const char * image = NULL, * again = NULL;
+    size_t image_size = 0, again_size = 0, len = 0, at, dis_size = 0;
+    struct Instruction instr;
+    DisasmStats stats;
+    char * text, * dis = NULL, * idx = NULL;
+    size_t idx_size = 0;
+    CodeIndexView view;
+    IndexCursor cur;
+    unsigned sum = 0;
+    FILE * out;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+            case 'n': n = strtol(optarg, NULL, 10); break;
+            case 'r': repeats = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n INSTRUCTIONS] [-r REPEATS]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    if (first == NULL || second == NULL) return 1;
+    if ((text = print_program(n, &len)) == NULL) return 1;
+
+    first->index_out = open_memstream(&idx, &idx_size);
+    if (first->index_out == NULL) return 1;
+    if (jas_assemble_buffer(first, text, len, &image, &image_size)) {
+        fprintf(stderr, "rtbench: program does not assemble\n");
+        return 1;
+    }
+    fclose(first->index_out);
+    first->index_out = NULL;
+
+    /* the index must have every start a linear decode finds */
+    if (readCodeIndex(&view, idx, idx_size) || view.num != n) {
+        fprintf(stderr, "rtbench: bad code index\n");
+        return 1;
+    }
+    for (at = 0, more = indexSeek(&view, 0, &cur); more;
+         more = indexNext(&view, &cur)) {
+        if ((size_t) cur.at != at
+                || (k = decodeInstruction(image, image_size, at,
+                                          &instr)) == 0) {
+            fprintf(stderr, "rtbench: index differs at %ld\n", cur.instr);
+            return 1;
+        }
+        at += k;
+    }
+
+    for (r = 0; r < repeats; r++) {
+        decoded = 0;
+        t0 = now();
+        for (at = 0; at < image_size; at += k, decoded++) {
+            if ((k = decodeInstruction(image, image_size, at, &instr)) == 0)
+                break;
+        }
+        t1 = now();
+        if (r == 0 || t1 - t0 < decode_best) decode_best = t1 - t0;
+
+        free(dis);
+        dis = NULL;
+        if ((out = open_memstream(&dis, &dis_size)) == NULL) return 1;
+        t0 = now();
+        if (disassemble(out, image, image_size, 0, &stats)) return 1;
+        fclose(out);
+        t1 = now();
+        if (r == 0 || t1 - t0 < print_best) print_best = t1 - t0;
+
+        /* as a loader or profiler would: any instruction, straight away */
+        seed = 1;
+        t0 = now();
+        for (i = 0; i < n; i++) {
+            indexSeek(&view, next(n), &cur);
+            sum += decodeInstruction(image, image_size, cur.at, &instr);
+        }
+        t1 = now();
+        if (r == 0 || t1 - t0 < seek_best) seek_best = t1 - t0;
+    }
+
+    if (decoded != n || stats.instrs != n || stats.dataWords != 0
+            || stats.dataBytes != 0) {
+        fprintf(stderr, "rtbench: %ld of %ld instructions decoded, "
+                "%ld words left as data\n", stats.instrs, n, stats.dataWords);
+        return 1;
+    }
+
+    if (jas_assemble_buffer(second, dis, dis_size, &again, &again_size)
+            || again_size != image_size || memcmp(image, again, image_size)) {
+        fprintf(stderr, "rtbench: images differ after a round trip\n");
+        return 1;
+    }
+
+    printf("%s: %ld instructions, %.1f MB image, round trip identical\n",
+           argv[0], n, image_size / 1e6);
+    printf("  decode         %7.1f Minstr/s  (%.3fs)\n",
+           n / 1e6 / decode_best, decode_best);
+    printf("  disassemble    %7.1f Minstr/s  (%.3fs, %.1f MB of text)\n",
+           n / 1e6 / print_best, print_best, dis_size / 1e6);
+    printf("  seek + decode  %7.1f Minstr/s  (%.3fs, index %.2f bytes/instr, "
+           "checksum %u)\n", n / 1e6 / seek_best, seek_best,
+           (double) idx_size / n, sum);
+
+    free(text);
+    free(dis);
+    free(idx);
+    jas_context_free(first);
+    jas_context_free(second);
+    return 0;
+}
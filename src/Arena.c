@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Trace.h"
+#include "Arena.h"
+
+struct ArenaBlock {
+    struct ArenaBlock * next;
+    struct ArenaBlock * prev; /* only kept for dedicated blocks */
+    size_t size;              /* usable bytes in data[]         */
+    size_t used;
+    double data[];            /* double keeps data[] aligned    */
+};
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+/* requests this big get a dedicated block */
+#define IS_LARGE(n) ((n) > ARENA_BLOCK / 4)
+
+/*
+ * Report hitting the memory limit, once per arena, unless it is quiet.
+ */
+static void * limitExceeded(Arena * arena) {
+    if (!arena->failed && !arena->quiet) {
+        fprintf(stderr, "error: Memory limit of %lu bytes exceeded.\n",
+                (unsigned long) arena->limit);
+    }
+    arena->failed = 1;
+    return NULL;
+}
+
+/*
+ * Take a new block of `size` usable bytes from malloc, honouring the limit.
+ */
+static struct ArenaBlock * newBlock(Arena * arena, size_t size) {
+    struct ArenaBlock * block;
+    size_t total = sizeof(struct ArenaBlock) + size;
+
+    if (arena->limit && arena->reserved + total > arena->limit)
+        return limitExceeded(arena);
+
+    block = (struct ArenaBlock *) malloc(total);
+    if (block == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        arena->failed = 1;
+        return NULL;
+    }
+
+    block->next = block->prev = NULL;
+    block->size = size;
+    block->used = 0;
+
+    arena->reserved += total;
+    if (arena->reserved > arena->peak) arena->peak = arena->reserved;
+
+    return block;
+}
+
+/*
+ * Allocate `size` bytes, aligned to ARENA_ALIGN. Returns NULL if out of
+ * memory or over the limit (already reported).
+ */
+void * arenaAlloc(Arena * arena, size_t size) {
+    struct ArenaBlock * block = arena->head;
+    void * ptr;
+
+    size = ALIGN_UP(size ? size : 1);
+    arena->allocs++;
+
+    if (IS_LARGE(size)) {
+        if ((block = newBlock(arena, size)) == NULL) return NULL;
+
+        block->used = size;
+        block->next = arena->large;
+        if (arena->large) arena->large->prev = block;
+        arena->large = block;
+
+        arena->used += size;
+        return block->data;
+    }
+
+    if (block == NULL || block->size - block->used < size) {
+        if ((block = newBlock(arena, ARENA_BLOCK)) == NULL) return NULL;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    ptr = (char *) block->data + block->used;
+    block->used += size;
+    arena->used += size;
+
+    return ptr;
+}
+
+/*
+ * Resize an allocation made from this arena, keeping its contents.
+ * Dedicated blocks are realloc'd; the latest allocation in the current shared
+ * block is extended in place when it fits; otherwise the data is copied into
+ * a fresh allocation and the old space is simply left behind.
+ */
+void * arenaGrow(Arena * arena, void * ptr, size_t oldSize, size_t newSize) {
+    struct ArenaBlock * block;
+    void * fresh;
+
+    if (ptr == NULL) return arenaAlloc(arena, newSize);
+
+    oldSize = ALIGN_UP(oldSize ? oldSize : 1);
+    newSize = ALIGN_UP(newSize);
+    if (newSize <= oldSize) return ptr;
+
+    if (IS_LARGE(oldSize)) {
+        /* `ptr` is the data[] of its own block */
+        struct ArenaBlock * prev, * next;
+        size_t total = sizeof(struct ArenaBlock) + newSize;
+
+        block = (struct ArenaBlock *)
+            ((char *) ptr - offsetof(struct ArenaBlock, data));
+
+        if (arena->limit && arena->reserved - oldSize + newSize > arena->limit)
+            return limitExceeded(arena);
+
+        prev = block->prev;
+        next = block->next;
+        block = (struct ArenaBlock *) realloc(block, total);
+        if (block == NULL) {
+            fprintf(stderr, "realloc() error.\n");
+            arena->failed = 1;
+            return NULL;
+        }
+
+        /* relink, the block may have moved */
+        if (prev) prev->next = block; else arena->large = block;
+        if (next) next->prev = block;
+
+        block->size = block->used = newSize;
+        arena->allocs++;
+        arena->reallocs++;
+        arena->used += newSize - oldSize;
+        arena->reserved += newSize - oldSize;
+        if (arena->reserved > arena->peak) arena->peak = arena->reserved;
+
+        return block->data;
+    }
+
+    /* last allocation in the current block? bump it further */
+    block = arena->head;
+    if (block && !IS_LARGE(newSize)
+            && (char *) ptr + oldSize == (char *) block->data + block->used
+            && block->used - oldSize + newSize <= block->size) {
+        block->used += newSize - oldSize;
+        arena->allocs++;
+        arena->used += newSize - oldSize;
+        return ptr;
+    }
+
+    if ((fresh = arenaAlloc(arena, newSize)) == NULL) return NULL;
+    memcpy(fresh, ptr, oldSize);
+    arena->reallocs++;
+    arena->used -= oldSize; /* left behind, no longer live */
+
+    return fresh;
+}
+
+/*
+ * Free everything the arena holds. The allocation count and peak are kept so
+ * they can still be reported afterwards.
+ */
+void arenaRelease(Arena * arena) {
+    struct ArenaBlock * block, * next;
+
+    for (block = arena->head; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+    for (block = arena->large; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+
+    arena->head = arena->large = NULL;
+    arena->used = arena->reserved = 0;
+    arena->failed = 0;
+}
+
+/*
+ * Free everything but the newest shared block, which is kept (emptied) for the
+ * next assembly so that a reused context starts without a trip to malloc.
+ * The statistics start over, so they describe that next assembly alone.
+ */
+void arenaReset(Arena * arena) {
+    struct ArenaBlock * keep = arena->head;
+
+    if (keep != NULL) arena->head = keep->next;
+    arenaRelease(arena);
+
+    if (keep != NULL) {
+        keep->next = NULL;
+        keep->used = 0;
+        arena->head = keep;
+        arena->reserved = sizeof(struct ArenaBlock) + keep->size;
+    }
+    arena->allocs = arena->reallocs = 0;
+    arena->peak = arena->reserved;
+}
+
+void arenaReport(const Arena * arena, const char * name) {
+    TRACE_TEXT(TR_ARENA, name, strlen(name), arena->allocs, arena->used,
+               arena->peak, 0);
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for data that lives exactly as long as one assembly.
+ *
+ * Small requests are carved out of shared blocks; large ones (over a quarter
+ * of a block) get a block of their own, which arenaGrow() can realloc in
+ * place. Nothing is freed individually: arenaRelease() drops every block at
+ * once, arenaReset() all but one.
+ */
+
+#define ARENA_BLOCK 65536   /* size of a shared block                  */
+#define ARENA_ALIGN 8       /* alignment of every returned pointer     */
+
+struct ArenaBlock;
+
+typedef struct Arena {
+    struct ArenaBlock * head;  /* current shared block, then older ones */
+    struct ArenaBlock * large; /* dedicated blocks, doubly linked       */
+
+    size_t limit;     /* max bytes reserved from malloc, 0 = no limit */
+    int failed;       /* set once an allocation has failed            */
+    int quiet;        /* hit the limit without reporting it           */
+
+    /* statistics */
+    size_t allocs;    /* number of arenaAlloc/arenaGrow calls          */
+    size_t reallocs;  /* arenaGrow calls that had to move or realloc   */
+    size_t used;      /* bytes handed out (live)                       */
+    size_t reserved;  /* bytes currently held from malloc              */
+    size_t peak;      /* high-water mark of `reserved`                 */
+} Arena;
+
+/** function prototypes **/
+void * arenaAlloc(Arena * arena, size_t size);
+void * arenaGrow(Arena * arena, void * ptr, size_t oldSize, size_t newSize);
+void arenaRelease(Arena * arena);
+void arenaReset(Arena * arena);
+void arenaReport(const Arena * arena, const char * name);
+
+#endif
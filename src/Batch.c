@@ -0,0 +1,585 @@
+#define _POSIX_C_SOURCE 200809L /* open_memstream, getline, strdup */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "Trace.h"
+#include "Batch.h"
+#include "BatchIO.h"
+#include "libjas.h"
+#include "JasStrings.h"
+#include "CodeIndex.h"
+
+/*
+ * Queue `in` to be assembled into `out`. A NULL `in` reads stdin. Returns
+ * nonzero if out of memory.
+ */
+int batchAdd(Batch * batch, const char * in, const char * out) {
+    BatchJob * job;
+
+    if (batch->num == batch->cap) {
+        long cap = batch->cap ? batch->cap * 2 : BATCH_MIN;
+        BatchJob * jobs = (BatchJob *) realloc(batch->jobs,
+                                               cap * sizeof(BatchJob));
+
+        if (jobs == NULL) {
+            fprintf(stderr, "realloc() error.\n");
+            return 1;
+        }
+        batch->jobs = jobs;
+        batch->cap = cap;
+    }
+
+    job = &batch->jobs[batch->num];
+    memset(job, 0, sizeof(BatchJob));
+
+    job->inFd = job->outFd = -1;
+    job->in = in ? strdup(in) : NULL;
+    job->out = strdup(out);
+    if ((in && job->in == NULL) || job->out == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        free(job->in);
+        free(job->out);
+        return 1;
+    }
+
+    batch->num++;
+    return 0;
+}
+
+/*
+ * Derive the output name for `in`: its extension swapped for BATCH_EXT, next
+ * to the input, or inside `dir` if one is given. The result is malloc'd.
+ */
+char * batchOutName(const char * in, const char * dir) {
+    const char * base = strrchr(in, '/');
+    const char * dot;
+    size_t stem, len;
+    char * name;
+
+    base = base ? base + 1 : in;
+    dot = strrchr(base, '.');
+
+    /* keep hidden files' names and never map an input onto itself */
+    if (dot == NULL || dot == base || strcmp(dot, BATCH_EXT) == 0)
+        dot = base + strlen(base);
+
+    if (dir != NULL) {
+        stem = dot - base;
+        len = strlen(dir) + 1 + stem + sizeof(BATCH_EXT);
+        if ((name = (char *) malloc(len)) == NULL) return NULL;
+        sprintf(name, "%s/%.*s%s", dir, (int) stem, base, BATCH_EXT);
+    } else {
+        stem = dot - in;
+        len = stem + sizeof(BATCH_EXT);
+        if ((name = (char *) malloc(len)) == NULL) return NULL;
+        sprintf(name, "%.*s%s", (int) stem, in, BATCH_EXT);
+    }
+
+    return name;
+}
+
+/* an input's name in diagnostics */
+#define NAME_OF(job) ((job)->in ? (job)->in : "(stdin)")
+
+/* by output name, then in the order given */
+static int compareOut(const void * a, const void * b) {
+    const BatchJob * x = *(const BatchJob * const *) a;
+    const BatchJob * y = *(const BatchJob * const *) b;
+    int c = strcmp(x->out, y->out);
+
+    return c ? c : (x > y) - (x < y);
+}
+
+/*
+ * Check that no two jobs write the same output, as two inputs with the same
+ * name in different directories would with one -o DIR. Returns nonzero,
+ * reported, if any do.
+ */
+int batchCheckOutputs(const Batch * batch) {
+    const BatchJob ** sorted;
+    long i;
+    int ret = 0;
+
+    if (batch->num < 2) return 0;
+
+    sorted = (const BatchJob **) malloc(batch->num * sizeof(BatchJob *));
+    if (sorted == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        return 1;
+    }
+    for (i = 0; i < batch->num; i++) sorted[i] = &batch->jobs[i];
+    qsort(sorted, batch->num, sizeof(BatchJob *), compareOut);
+
+    for (i = 1; i < batch->num; i++) {
+        if (strcmp(sorted[i - 1]->out, sorted[i]->out) != 0) continue;
+
+        fprintf(stderr, "error: `%s' and `%s' would both be written to"
+                " `%s'.\n", NAME_OF(sorted[i - 1]), NAME_OF(sorted[i]),
+                sorted[i]->out);
+        ret = 1;
+    }
+
+    free(sorted);
+    return ret;
+}
+
+/*
+ * Read jobs from a manifest, one per line: an input path, then optionally the
+ * output path. Blank lines and `#' comments are skipped. Outputs not given are
+ * derived as by batchOutName(). Returns nonzero on error, already reported.
+ */
+int batchManifest(Batch * batch, const char * path, const char * dir) {
+    FILE * file = fopen(path, "r");
+    char * line = NULL;
+    size_t size = 0;
+    int lineno = 0, ret = 0;
+
+    if (file == NULL) {
+        fprintf(stderr, STR_FILE_ERR, path);
+        return 1;
+    }
+
+    while (!ret && getline(&line, &size, file) != -1) {
+        char * field[3] = {NULL};
+        char * p = line;
+        int n = 0;
+
+        lineno++;
+
+        /* split on whitespace, up to a comment */
+        while (n < 3) {
+            while (isspace((unsigned char) *p)) p++;
+            if (*p == '\0' || *p == '#') break;
+
+            field[n++] = p;
+            while (*p && !isspace((unsigned char) *p)) p++;
+            if (*p) *p++ = '\0';
+        }
+
+        if (n == 0) continue;
+        if (n > 2) {
+            fprintf(stderr, "%s:%d: error: Expected an input and at most one"
+                    " output.\n", path, lineno);
+            ret = 1;
+        } else if (n == 2) {
+            ret = batchAdd(batch, field[0], field[1]);
+        } else {
+            char * out = batchOutName(field[0], dir);
+
+            ret = out ? batchAdd(batch, field[0], out) : 1;
+            free(out);
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return ret;
+}
+
+/*
+ * Assemble one job with `ctx`, reporting to `diag`. Returns nonzero if either
+ * file could not be opened.
+ */
+static int runJob(JasContext * ctx, BatchJob * job, FILE * diag) {
+    FILE * in = stdin, * out;
+
+    if (job->in != NULL && (in = fopen(job->in, "rb")) == NULL) {
+        fprintf(diag, STR_FILE_ERR, job->in);
+        job->err = 1;
+        return 1;
+    }
+
+    /* read back while streaming */
+    if ((out = fopen(job->out, "w+b")) == NULL) {
+        fprintf(diag, STR_OUT_ERR, job->out);
+        if (in != stdin) fclose(in);
+        job->err = 1;
+        return 1;
+    }
+
+    ctx->filename = job->in ? job->in : "(stdin)";
+    ctx->diag = diag;
+    job->err = jas_assemble_file(ctx, in, out);
+    job->stats = ctx->stats;
+
+    if (in != stdin) fclose(in);
+    fclose(out);
+
+    /* a source that failed leaves no object file behind */
+    if (job->err) remove(job->out);
+
+    return 0;
+}
+
+/*
+ * Assemble a job whose source batch I/O has already read, leaving the image
+ * for it to write. Returns nonzero if either file could not be opened.
+ */
+static int runStaged(JasContext * ctx, BatchJob * job, FILE * diag) {
+    const char * image;
+    size_t len;
+
+    switch (job->ioErr) {
+        case BIO_OPEN_IN:
+            fprintf(diag, STR_FILE_ERR, job->in);
+            job->err = 1;
+            return 1;
+
+        case BIO_OPEN_OUT:
+            fprintf(diag, STR_OUT_ERR, job->out);
+            job->err = 1;
+            return 1;
+
+        case BIO_READ:
+            fprintf(diag, "error: Could not read input.\n");
+            job->err = 1;
+            return 0;
+    }
+
+    ctx->filename = job->in;
+    ctx->diag = diag;
+    job->err = jas_assemble_buffer(ctx, job->src, job->srcLen, &image, &len);
+    job->stats = ctx->stats;
+    if (job->err) return 0;
+
+    /* the context's buffer is reused by its next job */
+    if ((job->image = (char *) malloc(len ? len : 1)) == NULL) {
+        fprintf(diag, "error: Could not write output.\n");
+        job->err = 1;
+        return 0;
+    }
+    memcpy(job->image, image, len);
+    job->imageLen = len;
+
+    return 0;
+}
+
+/* ------------------------------ Thread Pool ------------------------------- */
+
+struct Pool {
+    Batch * batch;
+    int staged;             /* sources come from batch I/O    */
+    int workers;            /* 0: jobs run on the caller      */
+    long next;              /* next job to hand out           */
+    long avail;             /* jobs that may be handed out    */
+    int failed;             /* jobs that did not run          */
+    JasContext * ctx;       /* the caller's, without workers  */
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   /* more jobs are available        */
+    pthread_cond_t done;    /* some job finished              */
+};
+
+struct Worker {
+    struct Pool * pool;
+    JasContext * ctx;
+    pthread_t thread;
+};
+
+/*
+ * Open OUT.idx for a job's code index as ctx's index_out, leaving its name in
+ * `name` to be freed. Returns nonzero if it could not be opened.
+ */
+static int openIndex(JasContext * ctx, const BatchJob * job, FILE * diag,
+                     char ** name) {
+    *name = (char *) malloc(strlen(job->out) + sizeof(CODE_INDEX_EXT));
+    if (*name == NULL) {
+        fprintf(diag, STR_OUT_ERR, job->out);
+        return 1;
+    }
+    sprintf(*name, "%s%s", job->out, CODE_INDEX_EXT);
+
+    if ((ctx->index_out = fopen(*name, "wb")) == NULL) {
+        fprintf(diag, STR_OUT_ERR, *name);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Run one job with `ctx`. Its diagnostics go to `diag` if given, or are kept
+ * with the job to be printed in turn.
+ */
+static int doJob(struct Pool * pool, JasContext * ctx, BatchJob * job,
+                 FILE * diag) {
+    FILE * own = diag;
+    char * indexName = NULL;
+    int failed;
+
+    /* the stream owns job->diag until it is closed */
+    if (own == NULL
+            && (own = open_memstream(&job->diag, &job->diagLen)) == NULL) {
+        job->err = 1;
+        return 1;
+    }
+
+    if (pool->batch->index && openIndex(ctx, job, own, &indexName)) {
+        job->err = 1;
+        failed = 1;
+    } else {
+        failed = pool->staged ? runStaged(ctx, job, own)
+                              : runJob(ctx, job, own);
+    }
+
+    /* a failed image leaves no index behind either */
+    if (ctx->index_out != NULL) {
+        if (fclose(ctx->index_out) && !job->err) {
+            fprintf(own, "error: Could not write code index.\n");
+            job->err = 1;
+        }
+        if (job->err) remove(indexName);
+        ctx->index_out = NULL;
+    }
+    free(indexName);
+
+    if (own != diag) fclose(own);
+    return failed;
+}
+
+static void * work(void * arg) {
+    struct Worker * self = (struct Worker *) arg;
+    struct Pool * pool = self->pool;
+
+    for (;;) {
+        BatchJob * job;
+        int failed;
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->next == pool->avail && pool->next < pool->batch->num)
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        if (pool->next == pool->batch->num) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        job = &pool->batch->jobs[pool->next++];
+        pthread_mutex_unlock(&pool->lock);
+
+        failed = doJob(pool, self->ctx, job, NULL);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->failed += failed;
+        job->done = 1;
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/* let the workers have jobs up to `avail` */
+static void release(struct Pool * pool, long avail) {
+    pthread_mutex_lock(&pool->lock);
+    pool->avail = avail;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* wait for job `j`, or run it here when there are no workers */
+static void finish(struct Pool * pool, long j, FILE * diag) {
+    BatchJob * job = &pool->batch->jobs[j];
+
+    if (pool->workers == 0) {
+        /* reporting straight out is only in order when nothing comes after */
+        pool->failed += doJob(pool, pool->ctx, job, pool->staged ? NULL : diag);
+        job->done = 1;
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (!job->done) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void print(const struct Pool * pool, BatchJob * job, FILE * diag) {
+    if (job->diag != NULL) {
+        fwrite(job->diag, 1, job->diagLen, diag);
+        free(job->diag);
+        job->diag = NULL;
+    } else if (pool->workers || pool->staged) {
+        fprintf(diag, "error: Could not collect diagnostics for `%s'.\n",
+                job->in ? job->in : "(stdin)");
+    }
+
+    if (job->ioErr == BIO_WRITE) {
+        fprintf(diag, "error: Could not write output.\n");
+        job->err = 1;
+    }
+}
+
+static JasContext * newContext(const Batch * batch) {
+    JasContext * ctx = jas_context_new();
+
+    if (ctx != NULL) {
+        ctx->max_errors = batch->maxErrors;
+        ctx->arena.limit = batch->maxMemory;
+        ctx->pipeline = batch->pipeline;
+        ctx->measure = batch->stats;
+        ctx->optimize = batch->optimize;
+        ctx->retain = batch->optimize;
+
+        /* a lone file gets the threads to itself */
+        if (batch->num == 1) ctx->threads = batch->threads;
+    }
+    return ctx;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* read the sources of jobs [lo, hi) and hand them to the workers */
+static void stageIn(Batch * batch, BatchIO * io, struct Pool * pool,
+                    long lo, long hi) {
+    long calls = io->syscalls;
+    double start = now();
+
+    batchIORead(io, batch->jobs + lo, hi - lo);
+    TRACE(TR_IO_READ, hi - lo, io->syscalls - calls, (now() - start) * 1e6, 0);
+
+    batch->ioGroups++;
+    if (pool->workers) release(pool, hi);
+}
+
+static void stageOut(Batch * batch, BatchIO * io, long lo, long hi) {
+    long calls = io->syscalls, j;
+    double start = now();
+
+    batchIOWrite(io, batch->jobs + lo, hi - lo);
+    TRACE(TR_IO_WRITE, hi - lo, io->syscalls - calls, (now() - start) * 1e6,
+          0);
+
+    /* as in runJob(), remove the outputs opened for sources that failed */
+    for (j = lo; j < hi; j++) {
+        BatchJob * job = &batch->jobs[j];
+        int opened = job->ioErr == BIO_OK || job->ioErr == BIO_WRITE;
+
+        if (opened && (job->err || job->ioErr == BIO_WRITE)) remove(job->out);
+    }
+}
+
+/*
+ * Assemble every queued job, printing each one's diagnostics to `diag` in
+ * queue order as soon as it and all before it are done. Returns the number of
+ * jobs whose files could not be opened; assembly errors are left in each job's
+ * `err`.
+ *
+ * With batch I/O the calling thread reads a group of sources ahead while the
+ * workers assemble the group before it, then writes that group's images.
+ */
+int batchRun(Batch * batch, FILE * diag) {
+    struct Worker * workers = NULL;
+    struct Pool pool;
+    BatchIO io;
+    int threads = batch->threads, i;
+    long lo, hi, group = 1, j;
+    double start = now();
+
+    memset(&pool, 0, sizeof(pool));
+    pool.batch = batch;
+    pool.avail = batch->num;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    /* batch I/O needs paths to open */
+    batch->ioUsed = batch->io;
+    for (j = 0; j < batch->num; j++) {
+        if (batch->jobs[j].in == NULL) batch->ioUsed = BATCH_IO_STDIO;
+    }
+    batch->ioUsed = batchIOInit(&io, batch->ioUsed);
+    batch->ioGroups = 0;
+
+    if (batch->ioUsed != BATCH_IO_STDIO) {
+        pool.staged = 1;
+        pool.avail = 0;
+        group = BATCH_IO_GROUP;
+    }
+
+    if (threads > batch->num) threads = batch->num;
+    if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+
+    if (threads > 1) {
+        TRACE(TR_THREADS, batch->num, threads, 0, 0);
+
+        workers = (struct Worker *) calloc(threads, sizeof(struct Worker));
+        if (workers == NULL) fprintf(stderr, "malloc() error.\n");
+
+        for (i = 0; workers && i < threads; i++) {
+            struct Worker * w = &workers[i];
+
+            w->pool = &pool;
+            if ((w->ctx = newContext(batch)) == NULL) break;
+            if (pthread_create(&w->thread, NULL, work, w)) {
+                fprintf(stderr, "pthread_create() error.\n");
+                jas_context_free(w->ctx);
+                break;
+            }
+            pool.workers++;
+        }
+    }
+
+    /* fewer threads than asked for still works, none at all runs here */
+    if (pool.workers == 0 && (pool.ctx = newContext(batch)) == NULL) {
+        pool.failed = batch->num;
+        goto done;
+    }
+
+    if (pool.staged && batch->num)
+        stageIn(batch, &io, &pool, 0, group < batch->num ? group : batch->num);
+
+    for (lo = 0; lo < batch->num; lo = hi) {
+        hi = lo + group < batch->num ? lo + group : batch->num;
+
+        /* read ahead while this group is assembled */
+        if (pool.staged && hi < batch->num)
+            stageIn(batch, &io, &pool, hi,
+                    hi + group < batch->num ? hi + group : batch->num);
+
+        for (j = lo; j < hi; j++) finish(&pool, j, diag);
+        if (pool.staged) stageOut(batch, &io, lo, hi);
+        for (j = lo; j < hi; j++) print(&pool, &batch->jobs[j], diag);
+    }
+
+done:
+    for (i = 0; i < pool.workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+        jas_context_free(workers[i].ctx);
+    }
+    free(workers);
+    jas_context_free(pool.ctx);
+
+    batch->ioSyscalls = io.syscalls;
+    batch->seconds = now() - start;
+    for (j = 0; j < batch->num; j++)
+        addStats(&batch->total, &batch->jobs[j].stats);
+    batchIOFree(&io);
+
+    pthread_cond_destroy(&pool.done);
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.lock);
+
+    return pool.failed;
+}
+
+void batchFree(Batch * batch) {
+    long j;
+
+    for (j = 0; j < batch->num; j++) {
+        free(batch->jobs[j].in);
+        free(batch->jobs[j].out);
+        free(batch->jobs[j].diag);
+        free(batch->jobs[j].src);
+        free(batch->jobs[j].image);
+    }
+    free(batch->jobs);
+
+    batch->jobs = NULL;
+    batch->num = batch->cap = 0;
+}
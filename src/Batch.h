@@ -0,0 +1,89 @@
+#ifndef BATCH_H
+#define BATCH_H
+/*
+ * Batch assembly
+ * --------------
+ *
+ * Many input/output pairs, assembled on a fixed pool of worker threads. Each
+ * worker owns one JasContext and reuses it from file to file, so no state is
+ * shared between files but the job list itself.
+ *
+ * Diagnostics are gathered per file and printed in the order the files were
+ * given, however the work was spread over the threads. With one thread the
+ * files are assembled in order on the calling thread and report directly.
+ *
+ * By default each file is opened and read by whoever assembles it. Setting
+ * `io` moves all file I/O to the calling thread instead, a group of files at
+ * a time, see BatchIO.h.
+ *
+ * With `index` set, each output OUT also gets its code index, written as
+ * OUT.idx by whoever assembled it (see CodeIndex.h).
+ *
+ * With `optimize` set, every context retains its program and applies the
+ * peephole rules to it (see Peephole.h); what they saved is in `total`.
+ *
+ * With `stats` set, every context measures its assemblies (see Stats.h) and
+ * batchRun adds up what all the jobs took.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "Stats.h"
+
+#define BATCH_MIN 16
+#define BATCH_MAX_THREADS 256
+
+/* default extension of derived output names */
+#define BATCH_EXT ".o"
+
+typedef struct BatchJob {
+    char * in;        /* input path, NULL for stdin */
+    char * out;       /* output path                */
+    char * diag;      /* collected diagnostics      */
+    size_t diagLen;
+    int err;          /* nonzero if the file failed */
+    int done;
+
+    /* staged through batch I/O instead, see BatchIO.h */
+    char * src;       /* whole input                */
+    size_t srcLen;
+    char * image;     /* output, not yet written    */
+    size_t imageLen;
+    int inFd, outFd;
+    int ioErr;        /* enum BatchIOError          */
+
+    JasStats stats;   /* what assembling it took    */
+} BatchJob;
+
+typedef struct Batch {
+    BatchJob * jobs;
+    long num, cap;
+
+    /* settings, applied to every worker's context */
+    int threads;
+    int maxErrors;
+    size_t maxMemory;
+    int io;           /* enum BatchIOMode, 0 for stdio */
+    int pipeline;     /* lex each file on a thread of its own */
+    int index;        /* write each image's code index beside it */
+    int stats;        /* measure each assembly, see Stats.h */
+    int optimize;     /* apply peephole rules, see Peephole.h */
+
+    /* filled in by batchRun */
+    int ioUsed;       /* io after any fallback         */
+    long ioGroups;    /* groups read and written       */
+    long ioSyscalls;  /* system calls made for file I/O */
+    double seconds;   /* wall time of the whole run    */
+    JasStats total;   /* every job's stats added up    */
+} Batch;
+
+/** function prototypes **/
+int batchAdd(Batch * batch, const char * in, const char * out);
+char * batchOutName(const char * in, const char * dir);
+int batchManifest(Batch * batch, const char * path, const char * dir);
+int batchCheckOutputs(const Batch * batch);
+int batchRun(Batch * batch, FILE * diag);
+void batchFree(Batch * batch);
+
+#endif
@@ -0,0 +1,377 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/stat.h>
+
+#include "Trace.h"
+#include "BatchIO.h"
+
+#define OUT_FLAGS (O_WRONLY | O_CREAT | O_TRUNC)
+#define OUT_MODE 0666
+
+/* what a completion was for: tagged into its user_data with the job index */
+enum { OP_OPEN_IN, OP_STATX, OP_READ, OP_CLOSE, OP_OPEN_OUT, OP_WRITE };
+
+#define TAG(i, op) (((unsigned long long) (i) << 3) | (op))
+#define TAG_JOB(t) ((long) ((t) >> 3))
+#define TAG_OP(t) ((int) ((t) & 7))
+
+const char * batchIOName(int mode) {
+    switch (mode) {
+        case BATCH_IO_BLOCKING: return "blocking";
+        case BATCH_IO_URING: return "io_uring";
+        default: return "stdio";
+    }
+}
+
+/*
+ * Get ready to move files for `mode`. io_uring falls back to blocking calls
+ * when the kernel refuses a ring. Returns the mode actually in use.
+ */
+int batchIOInit(BatchIO * io, int mode) {
+    int err;
+
+    memset(io, 0, sizeof(BatchIO));
+    io->ring.fd = -1;
+
+    if (mode == BATCH_IO_URING
+            && (err = uringInit(&io->ring, BATCH_IO_ENTRIES))) {
+        TRACE_TEXT(TR_NO_URING, strerror(err), strlen(strerror(err)), 0, 0, 0,
+                   0);
+        mode = BATCH_IO_BLOCKING;
+    }
+
+    io->mode = mode;
+    return mode;
+}
+
+void batchIOFree(BatchIO * io) {
+    if (io->mode == BATCH_IO_URING) uringFree(&io->ring);
+}
+
+static void fail(BatchJob * job, int err) {
+    if (job->ioErr == BIO_OK) job->ioErr = err;
+}
+
+/* --------------------------------- Blocking ------------------------------- */
+
+static void readBlocking(BatchIO * io, BatchJob * job) {
+    struct stat st;
+    size_t size;
+    ssize_t got;
+
+    io->syscalls++;
+    if ((job->inFd = open(job->in, O_RDONLY)) < 0) {
+        fail(job, BIO_OPEN_IN);
+        return;
+    }
+
+    io->syscalls++;
+    if (fstat(job->inFd, &st) != 0) {
+        fail(job, BIO_READ);
+    } else if ((job->src = (char *) malloc(st.st_size ? st.st_size : 1))
+                   == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        fail(job, BIO_READ);
+    } else {
+        size = st.st_size;
+        while (job->srcLen < size) {
+            io->syscalls++;
+            got = read(job->inFd, job->src + job->srcLen, size - job->srcLen);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                fail(job, BIO_READ);
+                break;
+            }
+            job->srcLen += got;
+        }
+    }
+
+    io->syscalls++;
+    close(job->inFd);
+    job->inFd = -1;
+
+    if (job->ioErr) return;
+
+    io->syscalls++;
+    if ((job->outFd = open(job->out, OUT_FLAGS, OUT_MODE)) < 0)
+        fail(job, BIO_OPEN_OUT);
+}
+
+static void writeBlocking(BatchIO * io, BatchJob * job) {
+    size_t done = 0;
+    ssize_t put;
+
+    while (done < job->imageLen) {
+        io->syscalls++;
+        put = write(job->outFd, job->image + done, job->imageLen - done);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) {
+            fail(job, BIO_WRITE);
+            break;
+        }
+        done += put;
+    }
+
+    io->syscalls++;
+    if (close(job->outFd) != 0) fail(job, BIO_WRITE);
+    job->outFd = -1;
+}
+
+/* --------------------------------- io_uring ------------------------------- */
+
+/*
+ * Queue reads (or writes) of `len` bytes at `buf` in chunks, hard-linked to a
+ * close of `fd` so that the descriptor goes even if a chunk fails. Returns the
+ * number of entries queued.
+ */
+static unsigned queueTransfer(Uring * ring, long i, int op, int fd,
+                              char * buf, size_t len) {
+    struct io_uring_sqe * sqe;
+    unsigned queued = 0;
+    size_t off;
+
+    for (off = 0; off < len; off += BATCH_IO_CHUNK) {
+        if ((sqe = uringGet(ring)) == NULL) break;
+
+        sqe->opcode = op == OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long) (buf + off);
+        sqe->len = len - off < BATCH_IO_CHUNK ? len - off : BATCH_IO_CHUNK;
+        sqe->off = off;
+        sqe->flags = IOSQE_IO_HARDLINK;
+        sqe->user_data = TAG(i, op);
+        queued++;
+    }
+
+    if ((sqe = uringGet(ring)) != NULL) {
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fd;
+        sqe->user_data = TAG(i, OP_CLOSE);
+        queued++;
+    }
+
+    return queued;
+}
+
+static unsigned queueOpen(Uring * ring, long i, int op, const char * path) {
+    struct io_uring_sqe * sqe = uringGet(ring);
+
+    if (sqe == NULL) return 0;
+
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long) path;
+    sqe->open_flags = op == OP_OPEN_IN ? O_RDONLY : OUT_FLAGS;
+    sqe->len = op == OP_OPEN_IN ? 0 : OUT_MODE;
+    sqe->user_data = TAG(i, op);
+    return 1;
+}
+
+/*
+ * Submit what is queued and take `count` completions, filing each result with
+ * its job. `moved` counts the bytes read or written per job.
+ */
+static void complete(BatchIO * io, BatchJob * jobs, long n, unsigned count,
+                     size_t * moved) {
+    struct io_uring_cqe cqe;
+    long enters = io->ring.enters;
+    long i;
+
+    if (uringSubmit(&io->ring, count) < 0) {
+        /* nothing can be trusted about this round */
+        for (i = 0; i < n; i++) fail(&jobs[i], BIO_READ);
+        io->syscalls += io->ring.enters - enters;
+        return;
+    }
+
+    while (count > 0) {
+        if (!uringReap(&io->ring, &cqe)) {
+            if (uringSubmit(&io->ring, count) < 0) break;
+            continue;
+        }
+        count--;
+
+        i = TAG_JOB(cqe.user_data);
+        switch (TAG_OP(cqe.user_data)) {
+            case OP_OPEN_IN:
+                if (cqe.res < 0) fail(&jobs[i], BIO_OPEN_IN);
+                else jobs[i].inFd = cqe.res;
+                break;
+
+            case OP_OPEN_OUT:
+                if (cqe.res < 0) fail(&jobs[i], BIO_OPEN_OUT);
+                else jobs[i].outFd = cqe.res;
+                break;
+
+            case OP_STATX:
+            case OP_READ:
+                if (cqe.res < 0) fail(&jobs[i], BIO_READ);
+                else moved[i] += cqe.res;
+                break;
+
+            case OP_WRITE:
+                if (cqe.res < 0) fail(&jobs[i], BIO_WRITE);
+                else moved[i] += cqe.res;
+                break;
+
+            default: /* closes */
+                break;
+        }
+    }
+
+    io->syscalls += io->ring.enters - enters;
+}
+
+static void readUring(BatchIO * io, BatchJob * jobs, long n) {
+    struct statx * stx = (struct statx *) calloc(n, sizeof(struct statx));
+    size_t * moved = (size_t *) calloc(n, sizeof(size_t));
+    struct io_uring_sqe * sqe;
+    unsigned count = 0;
+    long i;
+
+    if (stx == NULL || moved == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        for (i = 0; i < n; i++) fail(&jobs[i], BIO_READ);
+        free(stx);
+        free(moved);
+        return;
+    }
+
+    /* round 1: open and size every input */
+    for (i = 0; i < n; i++) {
+        count += queueOpen(&io->ring, i, OP_OPEN_IN, jobs[i].in);
+
+        if ((sqe = uringGet(&io->ring)) == NULL) continue;
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long) jobs[i].in;
+        sqe->len = STATX_SIZE;
+        sqe->off = (unsigned long) &stx[i];
+        sqe->user_data = TAG(i, OP_STATX);
+        count++;
+    }
+    complete(io, jobs, n, count, moved);
+
+    /* round 2: read each input whole and close it, open its output */
+    count = 0;
+    for (i = 0; i < n; i++) {
+        BatchJob * job = &jobs[i];
+        size_t size = stx[i].stx_size;
+
+        moved[i] = 0;
+        if (job->inFd < 0) {
+            fail(job, BIO_OPEN_IN);
+            continue;
+        }
+        if (!(stx[i].stx_mask & STATX_SIZE)) fail(job, BIO_READ);
+
+        if (job->ioErr == BIO_OK
+                && (job->src = (char *) malloc(size ? size : 1)) == NULL) {
+            fprintf(stderr, "malloc() error.\n");
+            fail(job, BIO_READ);
+        }
+
+        count += queueTransfer(&io->ring, i, OP_READ, job->inFd, job->src,
+                               job->ioErr ? 0 : size);
+        if (job->ioErr == BIO_OK)
+            count += queueOpen(&io->ring, i, OP_OPEN_OUT, job->out);
+    }
+    complete(io, jobs, n, count, moved);
+
+    for (i = 0; i < n; i++) {
+        BatchJob * job = &jobs[i];
+
+        job->inFd = -1; /* closed by the round */
+        if (job->ioErr == BIO_OK && moved[i] != stx[i].stx_size)
+            fail(job, BIO_READ);
+        job->srcLen = moved[i];
+    }
+
+    free(stx);
+    free(moved);
+}
+
+static void writeUring(BatchIO * io, BatchJob * jobs, long n) {
+    size_t * moved = (size_t *) calloc(n, sizeof(size_t));
+    unsigned count = 0;
+    long i;
+
+    if (moved == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        for (i = 0; i < n; i++) {
+            if (jobs[i].outFd >= 0) writeBlocking(io, &jobs[i]);
+        }
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (jobs[i].outFd < 0) continue;
+        count += queueTransfer(&io->ring, i, OP_WRITE, jobs[i].outFd,
+                               jobs[i].image, jobs[i].imageLen);
+    }
+    complete(io, jobs, n, count, moved);
+
+    for (i = 0; i < n; i++) {
+        if (jobs[i].outFd < 0) continue;
+        jobs[i].outFd = -1;
+        if (moved[i] != jobs[i].imageLen) fail(&jobs[i], BIO_WRITE);
+    }
+
+    free(moved);
+}
+
+/* ---------------------------------- Stages -------------------------------- */
+
+/*
+ * Load the sources of `n` jobs into memory and open their outputs. Failures
+ * are left in each job's `ioErr` for it to report.
+ */
+void batchIORead(BatchIO * io, BatchJob * jobs, long n) {
+    long i;
+
+    if (io->mode == BATCH_IO_URING) {
+        readUring(io, jobs, n);
+    } else {
+        for (i = 0; i < n; i++) readBlocking(io, &jobs[i]);
+    }
+
+    /* nothing is assembled for a job that already failed */
+    for (i = 0; i < n; i++) {
+        if (jobs[i].ioErr != BIO_OK) {
+            free(jobs[i].src);
+            jobs[i].src = NULL;
+            jobs[i].srcLen = 0;
+        }
+    }
+}
+
+/*
+ * Write out the images of `n` assembled jobs, closing their outputs, and let
+ * go of their sources and images.
+ */
+void batchIOWrite(BatchIO * io, BatchJob * jobs, long n) {
+    long i;
+
+    if (io->mode == BATCH_IO_URING) {
+        writeUring(io, jobs, n);
+    } else {
+        for (i = 0; i < n; i++) {
+            if (jobs[i].outFd >= 0) writeBlocking(io, &jobs[i]);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        free(jobs[i].src);
+        free(jobs[i].image);
+        jobs[i].src = jobs[i].image = NULL;
+        jobs[i].srcLen = jobs[i].imageLen = 0;
+    }
+}
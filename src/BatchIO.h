@@ -0,0 +1,60 @@
+#ifndef BATCHIO_H
+#define BATCHIO_H
+/*
+ * File I/O for batch assembly
+ * ---------------------------
+ *
+ * With thousands of small sources, opening, reading, writing and closing each
+ * file costs more than assembling it. Instead of each worker going through
+ * stdio, the batch reads a whole group of inputs into memory up front and
+ * writes the finished images back as a group:
+ *
+ *     read:   open and size every input, then read each and close it, and
+ *             open its output
+ *     write:  write each image and close its output
+ *
+ * With io_uring every step is one submission for the whole group, so a group
+ * of BATCH_IO_GROUP files costs a handful of system calls. The blocking
+ * backend does the same steps one call at a time; it is what io_uring falls
+ * back to when the kernel does not offer it.
+ */
+
+#include "Batch.h"
+#include "Uring.h"
+
+/* files read and written together */
+#define BATCH_IO_GROUP 64
+#define BATCH_IO_ENTRIES 256
+
+/* largest single read or write, well under what the kernel will do at once */
+#define BATCH_IO_CHUNK (1L << 30)
+
+enum BatchIOMode {
+    BATCH_IO_STDIO,    /* each worker opens its own files, see batchRun */
+    BATCH_IO_BLOCKING,
+    BATCH_IO_URING
+};
+
+/* what went wrong with a staged job, kept in BatchJob.ioErr */
+enum BatchIOError {
+    BIO_OK,
+    BIO_OPEN_IN,
+    BIO_READ,
+    BIO_OPEN_OUT,
+    BIO_WRITE
+};
+
+typedef struct BatchIO {
+    int mode;       /* enum BatchIOMode, after any fallback */
+    long syscalls;  /* I/O system calls made so far         */
+    Uring ring;
+} BatchIO;
+
+/** function prototypes **/
+int batchIOInit(BatchIO * io, int mode);
+void batchIORead(BatchIO * io, BatchJob * jobs, long n);
+void batchIOWrite(BatchIO * io, BatchJob * jobs, long n);
+void batchIOFree(BatchIO * io);
+const char * batchIOName(int mode);
+
+#endif
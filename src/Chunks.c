@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L /* open_memstream */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "Trace.h"
+#include "Chunks.h"
+#include "libjas.h"
+#include "parser.h"
+
+struct Task {
+    JasContext * part;
+    const JasContext * ctx; /* the caller's, with every label merged in */
+    const char * src;
+    size_t len;
+    int failed;
+    pthread_t thread;
+};
+
+static void * assembleTask(void * arg) {
+    struct Task * task = (struct Task *) arg;
+    JasContext * part = task->part;
+
+    lex_init(part, task->src, task->len);
+    assemble(part);
+    countStats(part, emit_tell(&part->emit));
+
+    task->failed = part->err || part->arena.failed;
+    return NULL;
+}
+
+static void * relocateTask(void * arg) {
+    struct Task * task = (struct Task *) arg;
+
+    task->failed = relocateLabels(task->part, task->ctx);
+    return NULL;
+}
+
+/*
+ * Run `fn` on every task, each on its own thread but the first, which runs on
+ * ours. Returns nonzero if any task failed or could not be started.
+ */
+static int runTasks(struct Task * tasks, int num, void * (* fn)(void *)) {
+    int i, started, failed = 0;
+
+    for (started = 1; started < num; started++) {
+        if (pthread_create(&tasks[started].thread, NULL, fn, &tasks[started]))
+            break;
+    }
+    /* whatever could not get a thread runs here */
+    for (i = started; i < num; i++) fn(&tasks[i]);
+    fn(&tasks[0]);
+
+    for (i = 1; i < started; i++) pthread_join(tasks[i].thread, NULL);
+    for (i = 0; i < num; i++) failed |= tasks[i].failed;
+
+    return failed;
+}
+
+/*
+ * Cut `len` bytes of source into at most `num` pieces of whole lines. Fills
+ * in `bounds` with num + 1 offsets and returns the number of pieces, which is
+ * less than asked for when lines are too long to cut evenly.
+ */
+static int cut(const char * src, size_t len, int num, size_t * bounds) {
+    const char * nl;
+    size_t at;
+    int i, pieces = 0;
+
+    bounds[0] = 0;
+    for (i = 1; i < num; i++) {
+        at = (size_t) ((double) len * i / num);
+        if (at <= bounds[pieces]) continue;
+
+        nl = (const char *) memchr(src + at - 1, '\n', len - at + 1);
+        if (nl == NULL) break;
+        at = nl - src + 1;
+        if (at >= len) break;
+
+        if (at > bounds[pieces]) bounds[++pieces] = at;
+    }
+    bounds[++pieces] = len;
+
+    return pieces;
+}
+
+/*
+ * Assemble `len` bytes at `src` for `ctx` in chunks over up to `threads`
+ * threads. On success returns 0, with the chunks' images ready to be written
+ * and every label merged into ctx's table. Returns nonzero if the source is
+ * too small to split or anything went wrong; nothing is reported then, and
+ * ctx must be reset before assembling the source serially.
+ */
+int assembleChunks(Chunks * chunks, JasContext * ctx, const char * src,
+                   size_t len, int threads) {
+    struct Task tasks[CHUNKS_MAX];
+    size_t bounds[CHUNKS_MAX + 1];
+    char * sink = NULL;
+    size_t sinkLen = 0, share;
+    FILE * discard;
+    long base = 0;
+    double t;
+    int num, i, failed = 0;
+
+    memset(chunks, 0, sizeof(Chunks));
+
+    if (threads > CHUNKS_MAX) threads = CHUNKS_MAX;
+    if ((size_t) threads > len / CHUNK_MIN) threads = len / CHUNK_MIN;
+    if (threads < 2 || (num = cut(src, len, threads, bounds)) < 2)
+        return 1;
+
+    /* whatever the chunks would report, the serial path reports again */
+    if ((discard = open_memstream(&sink, &sinkLen)) == NULL) return 1;
+
+    /* --max-memory bounds the assembly, not each piece of it; a piece that
+       runs out abandons the attempt like any other error */
+    share = ctx->arena.limit / num;
+    if (ctx->arena.limit && share == 0) share = 1;
+
+    memset(tasks, 0, sizeof(tasks));
+    for (i = 0; i < num; i++) {
+        JasContext * part = jas_context_new();
+
+        if (part == NULL) {
+            failed = 1;
+            break;
+        }
+        chunks->part[chunks->num++] = part;
+
+        /* the first error is enough to give up on */
+        part->filename = ctx->filename;
+        part->diag = discard;
+        part->max_errors = 1;
+        part->arena.limit = share;
+        part->arena.quiet = 1;
+        part->labels.defer = 1;
+        part->index_out = ctx->index_out; /* recorded here, written by ctx */
+        part->measure = ctx->measure;
+
+        tasks[i].part = part;
+        tasks[i].ctx = ctx;
+        tasks[i].src = src + bounds[i];
+        tasks[i].len = bounds[i + 1] - bounds[i];
+    }
+
+    if (!failed) failed = runTasks(tasks, num, assembleTask);
+
+    /* lay the images out back to back and define the labels there */
+    for (i = 0; !failed && i < num; i++) {
+        chunks->base[i] = base;
+        failed = mergeLabels(ctx, chunks->part[i], base);
+        if (!failed && ctx->index_out != NULL)
+            failed = mergeCodeIndex(ctx, chunks->part[i], base);
+        base += emit_tell(&chunks->part[i]->emit);
+    }
+    if (!failed && base > INT_MAX) failed = 1;
+
+    t = statsLap(ctx, NULL, 0);
+    if (!failed) failed = runTasks(tasks, num, relocateTask);
+    statsLap(ctx, &ctx->stats.resolve, t);
+
+    /* the parts' phases count, their totals are within this call's */
+    t = ctx->stats.total;
+    for (i = 0; !failed && i < num; i++)
+        addStats(&ctx->stats, &chunks->part[i]->stats);
+    ctx->stats.total = t;
+
+    fclose(discard);
+    free(sink);
+
+    if (failed) {
+        freeChunks(chunks);
+        return 1;
+    }
+
+    TRACE(TR_CHUNKS, num, len / num, 0, 0);
+    return 0;
+}
+
+/*
+ * Write the chunks' images to `out` in one go. Returns nonzero on error.
+ */
+int writeChunks(const Chunks * chunks, FILE * out) {
+    struct iovec iov[CHUNKS_MAX];
+    int i, first = 0, fd = fileno(out);
+    ssize_t put;
+
+    for (i = 0; i < chunks->num; i++) {
+        iov[i].iov_base = chunks->part[i]->emit.buf;
+        iov[i].iov_len = chunks->part[i]->emit.ptr;
+    }
+
+    /* whatever stdio holds goes first */
+    if (fflush(out)) return 1;
+
+    while (first < chunks->num) {
+        put = writev(fd, iov + first, chunks->num - first);
+        if (put < 0 && errno == EINTR) continue;
+        if (put < 0) return 1;
+
+        /* skip what went out, a short write may stop inside a chunk */
+        while (first < chunks->num && (size_t) put >= iov[first].iov_len) {
+            put -= iov[first].iov_len;
+            first++;
+        }
+        if (first < chunks->num) {
+            iov[first].iov_base = (char *) iov[first].iov_base + put;
+            iov[first].iov_len -= put;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Copy the chunks' images into `emit`, for callers that want one buffer.
+ * Returns nonzero if out of memory.
+ */
+int copyChunks(const Chunks * chunks, Emitter * emit) {
+    int i;
+
+    for (i = 0; i < chunks->num; i++) {
+        if (emit_bytes(emit, chunks->part[i]->emit.buf,
+                       chunks->part[i]->emit.ptr))
+            return 1;
+    }
+    return 0;
+}
+
+void freeChunks(Chunks * chunks) {
+    int i;
+
+    for (i = 0; i < chunks->num; i++) jas_context_free(chunks->part[i]);
+    chunks->num = 0;
+}
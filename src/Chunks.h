@@ -0,0 +1,47 @@
+#ifndef CHUNKS_H
+#define CHUNKS_H
+/*
+ * Chunk-parallel assembly
+ * -----------------------
+ *
+ * A large source is cut at line boundaries into chunks, each assembled on its
+ * own thread by its own context, into its own image starting at address 0.
+ * Every label reference in a chunk is kept on its fixup chain (the chunk's
+ * symbol table is deferred, see Labels.h), since no chunk knows where it will
+ * end up:
+ *
+ *     1. assemble all chunks at once
+ *     2. prefix-sum the image sizes into each chunk's base address
+ *     3. define each chunk's labels in the caller's table at base + location
+ *     4. patch every chunk's chains from that table, all chunks at once
+ *     5. write the images out back to back
+ *
+ * Instruction sizes never depend on label values, so the result is the same
+ * image the serial path makes. Anything out of the ordinary (an error in a
+ * chunk, a chunk outgrowing its share of arena.limit, a label defined twice
+ * across chunks or never) abandons the attempt, so that the serial path can
+ * redo the source and report it just as usual.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "Context.h"
+
+#define CHUNKS_MAX 64
+#define CHUNK_MIN (1L << 20) /* smallest source piece worth a thread */
+
+typedef struct Chunks {
+    int num;
+    JasContext * part[CHUNKS_MAX];
+    long base[CHUNKS_MAX];   /* address of each chunk's image in the whole */
+} Chunks;
+
+/** function prototypes **/
+int assembleChunks(Chunks * chunks, JasContext * ctx, const char * src,
+                   size_t len, int threads);
+int writeChunks(const Chunks * chunks, FILE * out);
+int copyChunks(const Chunks * chunks, Emitter * emit);
+void freeChunks(Chunks * chunks);
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Trace.h"
+#include "Context.h"
+#include "CodeIndex.h"
+
+/*
+ * Make room for `need` entries of `per` values in one of the index's arrays,
+ * doubling it. Returns 1 from the caller if out of memory.
+ */
+#define RESERVE(array, cap, need, per) \
+    do { \
+        if ((need) > (cap)) { \
+            long grown = (cap) ? (cap) * 2 : CODE_INDEX_MIN; \
+            void * tmp; \
+            while (grown < (need)) grown *= 2; \
+            tmp = arenaGrow(&ctx->arena, (array), \
+                            (cap) * (per) * sizeof(*(array)), \
+                            grown * (per) * sizeof(*(array))); \
+            if (tmp == NULL) return 1; \
+            (array) = tmp; \
+            (cap) = grown; \
+        } \
+    } while (0)
+
+/* record an instruction start, returns nonzero if out of memory */
+static int addStart(JasContext * ctx, long at) {
+    CodeIndex * ix = &ctx->code;
+    unsigned long delta = at - ix->last;
+
+    if (ix->num % CODE_INDEX_BLOCK == 0) {
+        RESERVE(ix->blocks, ix->capBlocks, ix->numBlocks + 1, 2);
+        ix->blocks[2 * ix->numBlocks] = at;
+        ix->blocks[2 * ix->numBlocks + 1] = ix->numDeltas;
+        ix->numBlocks++;
+    } else {
+        /* at most 5 bytes of 7 bits for a 32-bit distance */
+        RESERVE(ix->deltas, ix->capDeltas, ix->numDeltas + 5, 1);
+        do {
+            unsigned char byte = delta & 0x7f;
+
+            delta >>= 7;
+            ix->deltas[ix->numDeltas++] = byte | (delta ? 0x80 : 0);
+        } while (delta);
+    }
+
+    ix->last = at;
+    ix->num++;
+    return 0;
+}
+
+/* mark [start, end) as code, joining it to the run before if it touches */
+static int addRange(JasContext * ctx, long start, long end) {
+    CodeIndex * ix = &ctx->code;
+
+    if (ix->numRanges && ix->ranges[2 * ix->numRanges - 1] == start) {
+        ix->ranges[2 * ix->numRanges - 1] = end;
+        return 0;
+    }
+
+    RESERVE(ix->ranges, ix->capRanges, ix->numRanges + 1, 2);
+    ix->ranges[2 * ix->numRanges] = start;
+    ix->ranges[2 * ix->numRanges + 1] = end;
+    ix->numRanges++;
+    return 0;
+}
+
+/*
+ * Record an instruction of `len` bytes at image offset `at`. Instructions
+ * must come in address order. Returns nonzero if out of memory.
+ */
+int indexInstruction(JasContext * ctx, long at, long len) {
+    return addStart(ctx, at) || addRange(ctx, at, at + len);
+}
+
+/* a view of an index still being recorded */
+static void viewIndex(const CodeIndex * ix, CodeIndexView * view) {
+    view->size = 0;
+    view->num = ix->num;
+    view->block = CODE_INDEX_BLOCK;
+    view->numBlocks = ix->numBlocks;
+    view->numRanges = ix->numRanges;
+    view->numDeltas = ix->numDeltas;
+    view->blocks = ix->blocks;
+    view->ranges = ix->ranges;
+    view->deltas = ix->deltas;
+}
+
+/*
+ * Append the index `part` recorded for an image placed at `base` in ctx's.
+ * Returns nonzero if out of memory.
+ */
+int mergeCodeIndex(JasContext * ctx, const JasContext * part, long base) {
+    CodeIndexView view;
+    IndexCursor cur;
+    long i;
+    int more;
+
+    viewIndex(&part->code, &view);
+
+    for (more = indexSeek(&view, 0, &cur); more;
+         more = indexNext(&view, &cur)) {
+        if (addStart(ctx, base + cur.at)) return 1;
+    }
+    for (i = 0; i < view.numRanges; i++) {
+        if (addRange(ctx, base + view.ranges[2 * i],
+                     base + view.ranges[2 * i + 1]))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Write the index of an image of `size` bytes as a sidecar file, see above.
+ * Returns nonzero on a write error.
+ */
+int writeCodeIndex(const CodeIndex * ix, long size, FILE * out) {
+    unsigned header[CODE_INDEX_HEADER];
+
+    header[0] = CODE_INDEX_MAGIC;
+    header[1] = CODE_INDEX_VERSION;
+    header[2] = size;
+    header[3] = ix->num;
+    header[4] = CODE_INDEX_BLOCK;
+    header[5] = ix->numBlocks;
+    header[6] = ix->numRanges;
+    header[7] = ix->numDeltas;
+
+    fwrite(header, sizeof(unsigned), CODE_INDEX_HEADER, out);
+    fwrite(ix->blocks, 2 * sizeof(unsigned), ix->numBlocks, out);
+    fwrite(ix->ranges, 2 * sizeof(unsigned), ix->numRanges, out);
+    fwrite(ix->deltas, 1, ix->numDeltas, out);
+
+    TRACE(TR_CODE_INDEX, ix->num, ix->numBlocks, ix->numRanges,
+          CODE_INDEX_HEADER * sizeof(unsigned)
+          + 2 * sizeof(unsigned) * (ix->numBlocks + ix->numRanges)
+          + ix->numDeltas);
+
+    return ferror(out);
+}
+
+/*
+ * Forget every instruction start. The arrays go away with the context's
+ * arena.
+ */
+void clearCodeIndex(JasContext * ctx) {
+    memset(&ctx->code, 0, sizeof(CodeIndex));
+}
+
+/* ------------------------------- Reading ---------------------------------- */
+
+/*
+ * Read the sidecar file in `len` bytes at `data`, which must stay put while
+ * the view is used. Returns nonzero if it is not a code index.
+ */
+int readCodeIndex(CodeIndexView * view, const char * data, size_t len) {
+    const unsigned * header = (const unsigned *) data;
+    size_t need;
+
+    if (len < CODE_INDEX_HEADER * sizeof(unsigned)
+            || header[0] != CODE_INDEX_MAGIC
+            || header[1] != CODE_INDEX_VERSION || header[4] == 0)
+        return 1;
+
+    view->size = header[2];
+    view->num = header[3];
+    view->block = header[4];
+    view->numBlocks = header[5];
+    view->numRanges = header[6];
+    view->numDeltas = header[7];
+
+    need = (CODE_INDEX_HEADER + 2 * (size_t) view->numBlocks
+            + 2 * (size_t) view->numRanges) * sizeof(unsigned)
+           + view->numDeltas;
+    if (len < need
+            || view->numBlocks != (view->num + view->block - 1) / view->block)
+        return 1;
+
+    view->blocks = header + CODE_INDEX_HEADER;
+    view->ranges = view->blocks + 2 * view->numBlocks;
+    view->deltas = (const unsigned char *) (view->ranges + 2 * view->numRanges);
+    return 0;
+}
+
+/*
+ * Point `cur` at instruction number `instr`. Returns 0 if there is no such
+ * instruction (or the index is damaged), else nonzero.
+ */
+int indexSeek(const CodeIndexView * view, long instr, IndexCursor * cur) {
+    long block = instr / view->block, i;
+
+    if (instr < 0 || instr >= view->num) return 0;
+
+    cur->instr = instr - instr % view->block;
+    cur->at = view->blocks[2 * block];
+    cur->pos = view->blocks[2 * block + 1];
+
+    for (i = instr % view->block; i > 0; i--) {
+        if (!indexNext(view, cur)) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Move `cur` on to the next instruction. Returns 0 if there is none (or the
+ * index is damaged), else nonzero.
+ */
+int indexNext(const CodeIndexView * view, IndexCursor * cur) {
+    unsigned long delta = 0;
+    int shift = 0;
+
+    if (cur->instr + 1 >= view->num) return 0;
+    cur->instr++;
+
+    /* a block starts afresh */
+    if (cur->instr % view->block == 0) {
+        long block = cur->instr / view->block;
+
+        cur->at = view->blocks[2 * block];
+        cur->pos = view->blocks[2 * block + 1];
+        return 1;
+    }
+
+    do {
+        if (cur->pos >= view->numDeltas || shift > 28) return 0;
+        delta |= (unsigned long) (view->deltas[cur->pos] & 0x7f) << shift;
+        shift += 7;
+    } while (view->deltas[cur->pos++] & 0x80);
+
+    cur->at += delta;
+    return 1;
+}
+
+/*
+ * The number of the first instruction starting at or after image offset
+ * `addr`, or the number of instructions if there is none.
+ */
+long indexLocate(const CodeIndexView * view, long addr) {
+    long lo = 0, hi = view->numBlocks;
+    IndexCursor cur;
+    int more;
+
+    /* the last block starting at or before addr */
+    while (hi - lo > 1) {
+        long mid = lo + (hi - lo) / 2;
+
+        if ((long) view->blocks[2 * mid] <= addr) lo = mid;
+        else hi = mid;
+    }
+
+    for (more = indexSeek(view, lo * view->block, &cur); more;
+         more = indexNext(view, &cur)) {
+        if (cur.at >= addr) return cur.instr;
+    }
+    return view->num;
+}
@@ -0,0 +1,86 @@
+#ifndef CODEINDEX_H
+#define CODEINDEX_H
+/*
+ * Code index
+ * ----------
+ *
+ * Instructions are one, two or three words long and may sit between data, so
+ * finding where they start otherwise takes decoding the image from address 0.
+ * With a context's `index_out` set, every instruction start is recorded as it
+ * is emitted and written out at the end as a sidecar file:
+ *
+ *     header      8 words: magic, version, image size, instructions,
+ *                 instructions per block, blocks, ranges, delta bytes
+ *     blocks      2 words each: start of the block's first instruction, and
+ *                 where the rest of its starts are in the deltas
+ *     ranges      2 words each: [start, end) of a run of instructions,
+ *                 everything outside them is data
+ *     deltas      each start after a block's first, as the distance from the
+ *                 one before: a byte (7 bits, top bit set if more follow)
+ *
+ * Words are native ints, like the image's. A distance is almost always an
+ * instruction length, so a start costs little more than a byte, and the
+ * start of instruction k is found by reading one block entry and at most
+ * CODE_INDEX_BLOCK - 1 distances. A reader can thus seek to any instruction,
+ * or cut an image at block boundaries and decode the pieces on separate
+ * threads.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define CODE_INDEX_MAGIC   0x5844494a  /* "JIDX" */
+#define CODE_INDEX_VERSION 1
+#define CODE_INDEX_HEADER  8           /* words before the blocks */
+#define CODE_INDEX_BLOCK   64          /* instructions per block  */
+#define CODE_INDEX_MIN     256         /* first allocation, in entries */
+
+/* default extension of the sidecar file */
+#define CODE_INDEX_EXT ".idx"
+
+/* instruction starts as they are recorded */
+typedef struct CodeIndex {
+    long num;                /* instructions recorded                  */
+    long last;               /* start of the last one                  */
+
+    unsigned * blocks;       /* start, delta position for each block   */
+    long numBlocks, capBlocks;
+    unsigned * ranges;       /* start, end of each run of code         */
+    long numRanges, capRanges;
+    unsigned char * deltas;
+    long numDeltas, capDeltas;
+} CodeIndex;
+
+/* a sidecar file as read back */
+typedef struct CodeIndexView {
+    long size;               /* of the image it indexes                */
+    long num;                /* instructions                           */
+    long block;              /* instructions per block                 */
+    long numBlocks, numRanges, numDeltas;
+    const unsigned * blocks;
+    const unsigned * ranges;
+    const unsigned char * deltas;
+} CodeIndexView;
+
+/* a position in a view: instruction `instr` starts at `at` */
+typedef struct IndexCursor {
+    long instr;
+    long at;
+    long pos;                /* of the next delta                      */
+} IndexCursor;
+
+struct JasContext;
+
+/** function prototypes **/
+int indexInstruction(struct JasContext * ctx, long at, long len);
+int mergeCodeIndex(struct JasContext * ctx, const struct JasContext * part,
+                   long base);
+int writeCodeIndex(const CodeIndex * ix, long size, FILE * out);
+void clearCodeIndex(struct JasContext * ctx);
+
+int readCodeIndex(CodeIndexView * view, const char * data, size_t len);
+int indexSeek(const CodeIndexView * view, long instr, IndexCursor * cur);
+int indexNext(const CodeIndexView * view, IndexCursor * cur);
+long indexLocate(const CodeIndexView * view, long addr);
+
+#endif
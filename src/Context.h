@@ -0,0 +1,56 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+/*
+ * Assembler context
+ * -----------------
+ *
+ * Everything one assembly reads and writes: the lexer's position, the parser's
+ * current token, the image being emitted, the symbol table and the arena they
+ * all allocate from. Nothing lives in globals, so contexts are independent of
+ * one another and any number of them may be in use at once, one per thread.
+ *
+ * A context is reset between assemblies rather than rebuilt, which keeps its
+ * output buffer and a block of its arena around for the next source.
+ */
+
+#include <stdio.h>
+
+#include "Arena.h"
+#include "CodeIndex.h"
+#include "Emit.h"
+#include "Labels.h"
+#include "Statements.h"
+#include "Stats.h"
+#include "lexer.h"
+
+typedef struct JasContext {
+    /* settings, kept across resets */
+    const char * filename;  /* name used in diagnostics                     */
+    FILE * diag;            /* where diagnostics go                         */
+    int max_errors;         /* errors to print before giving up, 0 = all    */
+    int threads;            /* threads a large source may be split over     */
+    int pipeline;           /* lex on a thread of its own, see Pipeline.h   */
+    int retain;             /* encode after parsing, see Statements.h       */
+    FILE * index_out;       /* if set, where the code index goes, see
+                               CodeIndex.h                                 */
+    int measure;            /* time phases into stats, see Stats.h          */
+    int optimize;           /* apply peephole rules, needs retain, see
+                               Peephole.h                                  */
+
+    /* outcome of the current assembly */
+    int err;                /* set once any error was reported              */
+    int num_errors;         /* number of errors printed                     */
+    JasStats stats;         /* what it took, see Stats.h                    */
+
+    Lexer lex;
+    Token token;            /* the parser's current token                   */
+    struct TokenRing * ring; /* if set, next_tok() takes tokens from here  */
+    Emitter emit;
+    SymbolTable labels;
+    Statements stmts;       /* the program, while retaining it              */
+    CodeIndex code;         /* instruction starts, with index_out set       */
+    Arena arena;            /* owns everything that lives as long as one
+                               assembly; arena.limit is a setting too       */
+} JasContext;
+
+#endif
@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "Trace.h"
+#include "Disasm.h"
+#include "Registers.h"
+
+/* parts of the instruction word Instruction.h has no names for */
+#define OPCODE_MASK 0x1ff
+#define TYPE_MASK   0x3
+#define FIELD_MASK  0x7f
+#define UNUSED_BITS 0x3c00
+
+/* data words per `dw' line */
+#define DATA_PER_LINE 8
+
+/* register sizes of a reading: direct operands, then indirect ones */
+#define DIRECT_SHORT   1
+#define INDIRECT_SHORT 2
+
+/* the order readings are tried in, with and without `.s' */
+static const int readings[2][4] = {
+    {0, DIRECT_SHORT | INDIRECT_SHORT, INDIRECT_SHORT, DIRECT_SHORT},
+    {DIRECT_SHORT | INDIRECT_SHORT, DIRECT_SHORT, INDIRECT_SHORT, 0}
+};
+
+/* what each offset code stands for, in steps of the operand's size */
+static const int offsetSteps[R_OFF_CUSTOM] = {0, 1, 2, 3, -3, -2, -1};
+
+/*
+ * Read one operand out of the instruction word. An operand with a word of its
+ * own takes words[*next]; `custom` says whether an empty offset field means
+ * there is one. Returns 0 if the bits cannot be this operand.
+ */
+static int decodeOperand(struct Operand * op, unsigned type, unsigned bits,
+                         int isShort, int custom, const int * words,
+                         int avail, int * next) {
+    char name[8];
+
+    op->type = type;
+    op->size = isShort ? OPSZ_SHORT : OPSZ_LONG;
+
+    if (type == OT_CONST) {
+        if (bits != 0 || *next == avail) return 0;
+
+        /* sized like the literal will be when read back */
+        op->value = words[(*next)++];
+        op->size = (CHAR_MIN <= op->value && op->value <= CHAR_MAX)
+                   ? OPSZ_SHORT : OPSZ_LONG;
+        return 1;
+    }
+
+    if (type == OT_REG_OFFSET && bits == 0 && custom) {
+        if (*next == avail) return 0;
+
+        /* the register is not encoded, any of the right size will do */
+        op->offset = words[(*next)++];
+        op->value = isShort ? 1 : 0;
+        return 1;
+    }
+
+    if (type == OT_REG_OFFSET) {
+        if (bits >> 4 == R_OFF_CUSTOM) return 0;
+
+        op->offset = offsetSteps[bits >> 4] * (isShort ? 1 : 4);
+        bits &= 0xf;
+    }
+
+    op->value = bits;
+    return getRegisterName(op->value, isShort, name);
+}
+
+/*
+ * One reading of an instruction's words: `sizes' of its registers, and for
+ * each operand (bit 0, bit 1) whether an empty offset field is custom.
+ * Returns the number of words it takes if it checks and encodes back to the
+ * same words, else 0.
+ */
+static int tryReading(const int * words, int avail, int sizes, int custom,
+                      struct Instruction * instr) {
+    unsigned word = words[0];
+    int opcode = word & OPCODE_MASK;
+    const struct IsaOpcode * isa = &isaOpcodes[opcode];
+    const struct InstrRecord * first =
+        &instrLookup[isaOpcodes[isa->primary].record];
+    int arity = isaArity[(int) instrLookup[isa->record].type];
+    struct Operand * ops[2];
+    struct Instruction checked;
+    int encoded[3];
+    int i, next = 1;
+
+    memset(instr, 0, sizeof(struct Instruction));
+    ops[0] = &instr->op1;
+    ops[1] = &instr->op2;
+
+    /* as the text will have it: the name finds the mnemonic's first form */
+    instr->name = first->name;
+    instr->type = first->type;
+    instr->opcode = first->opcode;
+
+    if (word & SIZE_BIT)
+        instr->size = OPSZ_SHORT;
+    else if (sizes == DIRECT_SHORT || sizes == INDIRECT_SHORT)
+        instr->size = OPSZ_LONG; /* lets indirect operands of either size by */
+
+    for (i = 0; i < 2; i++) {
+        unsigned type = word >> (i ? TYPE2_OFFSET : TYPE1_OFFSET) & TYPE_MASK;
+        unsigned bits = word >> (i ? OP2_OFFSET : OP1_OFFSET) & FIELD_MASK;
+        int isShort = sizes & (type == OT_REG ? DIRECT_SHORT : INDIRECT_SHORT);
+
+        /* an operand the instruction doesn't have is all zeroes */
+        if (i >= arity) {
+            if (type != 0 || bits != 0) return 0;
+            continue;
+        }
+
+        if (!decodeOperand(ops[i], type, bits, isShort, custom >> i & 1,
+                           words, avail, &next))
+            return 0;
+    }
+
+    /* checking settles the operands' sizes, keep the ones to print */
+    checked = *instr;
+    if (checkInstruction(&checked) != IC_OK || checked.opcode != opcode)
+        return 0;
+
+    if (encodeInstruction(checked.opcode, checked.size, &checked.op1,
+                          &checked.op2, encoded) != next
+            || memcmp(encoded, words, next * sizeof(int)))
+        return 0;
+
+    return next;
+}
+
+/*
+ * Decode the instruction at image offset `at` into `instr`, with its operands
+ * as they are to be printed. Returns its length in bytes, or 0 if the words
+ * there are not an instruction jas would encode that way.
+ */
+int decodeInstruction(const char * image, size_t len, size_t at,
+                      struct Instruction * instr) {
+    int words[3], avail, sizes, custom, customs, i, n;
+    unsigned word;
+
+    if (at > len) return 0;
+    avail = (len - at) / sizeof(int);
+    if (avail > 3) avail = 3;
+    if (avail == 0) return 0;
+    memcpy(words, image + at, avail * sizeof(int));
+
+    word = words[0];
+    if ((word & UNUSED_BITS) || isaOpcodes[word & OPCODE_MASK].record == -1)
+        return 0;
+
+    /* an empty offset field may or may not have a word of its own */
+    customs = 0;
+    for (i = 0; i < 2; i++) {
+        unsigned type = word >> (i ? TYPE2_OFFSET : TYPE1_OFFSET) & TYPE_MASK;
+        unsigned bits = word >> (i ? OP2_OFFSET : OP1_OFFSET) & FIELD_MASK;
+        if (type == OT_REG_OFFSET && bits == 0) customs |= 1 << i;
+    }
+
+    /* every subset of the empty fields, all custom first, since a custom
+       offset only encodes back at the register size it was written for */
+    custom = customs;
+    for (;;) {
+        for (i = 0; i < 4; i++) {
+            sizes = readings[(word & SIZE_BIT) != 0][i];
+            if ((n = tryReading(words, avail, sizes, custom, instr)))
+                return n * sizeof(int);
+        }
+        if (custom == 0) break;
+        custom = (custom - 1) & customs;
+    }
+
+    return 0;
+}
+
+static void printOperand(FILE * out, const struct Operand * op) {
+    char name[8];
+
+    if (op->type == OT_CONST) {
+        fprintf(out, "%d", op->value);
+        return;
+    }
+
+    getRegisterName(op->value, op->size == OPSZ_SHORT, name);
+
+    if (op->type == OT_REG)
+        fputs(name, out);
+    else if (op->type == OT_REG_ACCESS)
+        fprintf(out, "[%s]", name);
+    else if (op->offset < 0)
+        fprintf(out, "[%s - %lu]", name, (unsigned long) -(long) op->offset);
+    else
+        fprintf(out, "[%s + %d]", name, op->offset);
+}
+
+/*
+ * Print a decoded instruction as source, without ending the line. Returns
+ * nonzero on a write error.
+ */
+int printInstruction(FILE * out, const struct Instruction * instr) {
+    const char * c;
+    int arity = isaArity[(int) instr->type];
+
+    fputc('\t', out);
+    for (c = instr->name; *c; c++) fputc(tolower((unsigned char) *c), out);
+
+    if (instr->size == OPSZ_SHORT) fputs(".s", out);
+    else if (instr->size == OPSZ_LONG) fputs(".l", out);
+
+    if (arity > 0) {
+        fputc('\t', out);
+        printOperand(out, &instr->op1);
+    }
+    if (arity > 1) {
+        fputs(", ", out);
+        printOperand(out, &instr->op2);
+    }
+
+    return ferror(out);
+}
+
+/* write out the data words gathered so far as one `dw' line */
+static void flushData(FILE * out, const int * data, int * num, long at,
+                      int addresses) {
+    int i;
+
+    if (*num == 0) return;
+
+    fputs("\tdw\t", out);
+    for (i = 0; i < *num; i++)
+        fprintf(out, "%s%d", i ? ", " : "", data[i]);
+    if (addresses)
+        fprintf(out, "\t; %06lx", at - *num * (long) sizeof(int));
+    fputc('\n', out);
+
+    *num = 0;
+}
+
+/* the bytes [from, to) as data: whole words as `dw', the rest as `db' */
+static void printData(FILE * out, const char * image, size_t from, size_t to,
+                      int addresses, DisasmStats * counts) {
+    int data[DATA_PER_LINE], num = 0, n;
+
+    for (; to - from >= sizeof(int); from += sizeof(int)) {
+        memcpy(&data[num++], image + from, sizeof(int));
+        counts->dataWords++;
+
+        if (num == DATA_PER_LINE)
+            flushData(out, data, &num, from + sizeof(int), addresses);
+    }
+    flushData(out, data, &num, from, addresses);
+
+    if (from == to) return;
+
+    fputs("\tdb\t", out);
+    for (n = 0; from < to; from++, n++) {
+        fprintf(out, "%s%d", n ? ", " : "", (signed char) image[from]);
+        counts->dataBytes++;
+    }
+    fputc('\n', out);
+}
+
+/*
+ * Disassemble a whole image to `out`, one statement a line, each followed by
+ * its offset as a comment if `addresses` is set. Fills in `stats` if not
+ * NULL. Returns nonzero on a write error.
+ */
+int disassemble(FILE * out, const char * image, size_t len, int addresses,
+                DisasmStats * stats) {
+    DisasmStats counts = {0};
+    struct Instruction instr;
+    int data[DATA_PER_LINE], num = 0, n;
+    size_t at = 0;
+
+    while (at < len) {
+        if ((n = decodeInstruction(image, len, at, &instr))) {
+            flushData(out, data, &num, at, addresses);
+            printInstruction(out, &instr);
+            if (addresses) fprintf(out, "\t; %06lx", (long) at);
+            fputc('\n', out);
+
+            counts.instrs++;
+            at += n;
+        } else if (len - at >= sizeof(int)) {
+            memcpy(&data[num++], image + at, sizeof(int));
+            counts.dataWords++;
+            at += sizeof(int);
+
+            if (num == DATA_PER_LINE)
+                flushData(out, data, &num, at, addresses);
+        } else {
+            /* fewer bytes left than a word */
+            flushData(out, data, &num, at, addresses);
+            printData(out, image, at, len, addresses, &counts);
+            at = len;
+        }
+    }
+    flushData(out, data, &num, at, addresses);
+
+    TRACE(TR_DISASM, counts.instrs, counts.dataWords, counts.dataBytes, 0);
+
+    if (stats != NULL) *stats = counts;
+    return ferror(out);
+}
+
+/*
+ * Disassemble an image as disassemble() does, but decode only where its code
+ * index says instructions start; everything else is data. Returns nonzero on
+ * a write error.
+ */
+int disassembleIndexed(FILE * out, const char * image, size_t len,
+                       const CodeIndexView * index, int addresses,
+                       DisasmStats * stats) {
+    DisasmStats counts = {0};
+    struct Instruction instr;
+    IndexCursor cur;
+    size_t at = 0;
+    int more, n;
+
+    for (more = indexSeek(index, 0, &cur); more && (size_t) cur.at < len;
+         more = indexNext(index, &cur)) {
+        /* overlapping starts are not from jas, skip them */
+        if ((size_t) cur.at < at) continue;
+
+        printData(out, image, at, cur.at, addresses, &counts);
+        at = cur.at;
+
+        /* what will not decode comes out as data before the next start */
+        if ((n = decodeInstruction(image, len, at, &instr))) {
+            printInstruction(out, &instr);
+            if (addresses) fprintf(out, "\t; %06lx", (long) at);
+            fputc('\n', out);
+
+            counts.instrs++;
+            at += n;
+        }
+    }
+    printData(out, image, at, len, addresses, &counts);
+
+    if (stats != NULL) *stats = counts;
+    return ferror(out);
+}
@@ -0,0 +1,54 @@
+#ifndef DISASM_H
+#define DISASM_H
+/*
+ * Disassembly
+ * -----------
+ *
+ * Turns an image back into source that assembles to the same bytes. Words
+ * are decoded with the same generated tables the encoder runs on (see
+ * Isa.def), and every instruction found is checked and encoded again before
+ * it is accepted, so what comes out is exactly what jas would need to see.
+ *
+ * An image does not say where code stops and data starts, so whatever does
+ * not decode to an instruction that encodes back to the same words comes
+ * out as `dw' (and a short tail as `db'). Two encodings are ambiguous and
+ * decoded as the likelier one, backing off to the other only if that fails
+ * to encode back: an empty [register + offset] field is either a custom
+ * offset in the next word or `[r0 + 0]', and an instruction without `.s'
+ * may have used long or short register names.
+ *
+ * A register numbered above 15 in a [register + offset] field runs into the
+ * offset code above it, so such an operand decodes as some other register
+ * and offset that encode to the same bits, or as data when none do.
+ *
+ * Labels are gone by then, so references come out as the constant addresses
+ * they were resolved to.
+ *
+ * Given the image's code index (see CodeIndex.h), data is never taken for
+ * code: only the recorded starts are decoded, and everything between is data.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "Instruction.h"
+#include "CodeIndex.h"
+
+/* counts kept by disassemble() */
+typedef struct DisasmStats {
+    long instrs;      /* instructions decoded          */
+    long dataWords;   /* words that came out as `dw'   */
+    long dataBytes;   /* tail bytes that came out as `db' */
+} DisasmStats;
+
+/** function prototypes **/
+int decodeInstruction(const char * image, size_t len, size_t at,
+                      struct Instruction * instr);
+int printInstruction(FILE * out, const struct Instruction * instr);
+int disassemble(FILE * out, const char * image, size_t len, int addresses,
+                DisasmStats * stats);
+int disassembleIndexed(FILE * out, const char * image, size_t len,
+                       const CodeIndexView * index, int addresses,
+                       DisasmStats * stats);
+
+#endif
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "Trace.h"
+#include "Emit.h"
+
+/*
+ * Write `n` bytes to the output at the current file offset.
+ */
+static int writeAll(int fd, const char * bytes, long n) {
+    ssize_t done;
+
+    while (n > 0) {
+        if ((done = write(fd, bytes, n)) < 0) {
+            fprintf(stderr, "write() error.\n");
+            return 1;
+        }
+        bytes += done;
+        n -= done;
+    }
+    return 0;
+}
+
+/*
+ * Write out the whole window and start a new one after it.
+ */
+static int flushWindow(Emitter * e) {
+    if (writeAll(e->fd, e->buf, e->ptr)) return 1;
+
+    e->base += e->ptr;
+    e->ptr = 0;
+    e->flushes++;
+    return 0;
+}
+
+/*
+ * Stream the image straight into `out` instead of buffering all of it.
+ * Only regular files open for reading and writing qualify, since forward
+ * references are read back and patched in place later. Returns 0 if
+ * streaming, nonzero if everything stays buffered.
+ */
+int emit_stream(Emitter * e, FILE * out) {
+    struct stat st;
+    int fd = fileno(out);
+
+    if (fd < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode))
+        return 1;
+
+    /* fixup chains are read back from the file to be walked */
+    if ((fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDWR)
+        return 1;
+
+    /* nothing may sit in stdio's buffer ahead of our own writes */
+    fflush(out);
+    if ((e->origin = lseek(fd, 0, SEEK_CUR)) < 0) return 1;
+
+    e->fd = fd;
+    return 0;
+}
+
+/*
+ * Slow path of emit_reserve(). While streaming, a full window is flushed
+ * first; otherwise (or if that is still not enough) the buffer doubles until
+ * `n` more bytes fit. Returns 0 on success.
+ */
+int emit_grow(Emitter * e, long n) {
+    long cap = e->cap ? e->cap : EMIT_MIN;
+    char * temp;
+
+    if (e->fd >= 0 && e->ptr >= EMIT_WINDOW) {
+        if (flushWindow(e)) return 1;
+        if (e->ptr + n <= e->cap) return 0;
+    }
+
+    while (cap < e->ptr + n) cap *= 2;
+
+    temp = (char *) realloc(e->buf, cap);
+    if (temp == NULL) {
+        fprintf(stderr, "realloc() error.\n");
+        return 1;
+    }
+
+    e->buf = temp;
+    e->cap = cap;
+    e->growths++;
+
+    TRACE(TR_EMIT_GROW, cap, 0, 0, 0);
+    return 0;
+}
+
+/*
+ * Overwrite the word at image offset `at`, which must already be emitted.
+ * Words are never split across a flush, so it is either wholly in the window
+ * or wholly in the file. Returns 0 on success.
+ */
+int emit_patch_u32(Emitter * e, long at, int value) {
+    if (at >= e->base) {
+        memcpy(e->buf + (at - e->base), &value, sizeof(value));
+        return 0;
+    }
+
+    if (pwrite(e->fd, &value, sizeof(value), e->origin + at)
+            != sizeof(value)) {
+        fprintf(stderr, "pwrite() error.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Read back the word at image offset `at`, from the window or the file.
+ * Returns 0 on success.
+ */
+int emit_peek_u32(Emitter * e, long at, int * value) {
+    if (at >= e->base) {
+        memcpy(value, e->buf + (at - e->base), sizeof(*value));
+        return 0;
+    }
+
+    if (pread(e->fd, value, sizeof(*value), e->origin + at)
+            != sizeof(*value)) {
+        fprintf(stderr, "pread() error.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Write whatever of the image has not reached `out` yet.
+ */
+int emit_finish(Emitter * e, FILE * out) {
+    if (e->fd >= 0) return flushWindow(e);
+
+    if (fwrite(e->buf, sizeof(char), e->ptr, out) != (size_t) e->ptr)
+        return 1;
+    return 0;
+}
+
+/*
+ * Throw away a failed image: whatever was streamed out already is cut off
+ * again, so the output ends up as empty as if nothing had been written, and
+ * another image may be streamed in its place.
+ */
+void emit_discard(Emitter * e) {
+    if (e->fd < 0) return;
+
+    if (ftruncate(e->fd, e->origin) || lseek(e->fd, e->origin, SEEK_SET) < 0)
+        fprintf(stderr, "ftruncate() error.\n");
+}
+
+/*
+ * Start a new image, keeping the buffer for reuse.
+ */
+void emit_reset(Emitter * e) {
+    e->ptr = 0;
+    e->base = 0;
+    e->fd = -1;
+    e->origin = 0;
+    e->growths = e->flushes = 0;
+}
+
+/*
+ * Drop the buffer, ready for the next assembly.
+ */
+void emit_free(Emitter * e) {
+    free(e->buf);
+    e->buf = NULL;
+    e->cap = 0;
+    emit_reset(e);
+}
@@ -0,0 +1,84 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Output buffer for the assembled image.
+ *
+ * Every encoder writes through the emit_* calls below, each of which does a
+ * single capacity check and otherwise stores straight into the buffer. When
+ * the check fails the buffer doubles, so emitting n bytes costs O(log n)
+ * reallocations.
+ *
+ * When the output is a regular file the buffer is only a window onto it:
+ * once the window passes EMIT_WINDOW bytes, its contents are written out and
+ * it starts over. Placeholders that have already left the window are patched
+ * in the file with pwrite(), so memory stays bounded no matter how large the
+ * image gets.
+ */
+
+/* first allocation of the buffer, in bytes */
+#define EMIT_MIN 4096
+
+/* flush the window to the output once it holds this many bytes */
+#define EMIT_WINDOW (1L << 20)
+
+/* the image being emitted, one per JasContext */
+typedef struct Emitter {
+    char * buf;     /* the window, or the whole image when not streaming */
+    long ptr;       /* next free byte in `buf`                           */
+    long cap;
+    long base;      /* image offset of buf[0]                            */
+
+    int fd;         /* output file while streaming, -1 otherwise         */
+    long origin;    /* file offset of image offset 0                     */
+
+    long growths;   /* number of times the buffer was reallocated        */
+    long flushes;   /* number of times the window was written out        */
+} Emitter;
+
+/** function prototypes **/
+int emit_stream(Emitter * e, FILE * out);
+int emit_grow(Emitter * e, long n);
+int emit_patch_u32(Emitter * e, long at, int value);
+int emit_peek_u32(Emitter * e, long at, int * value);
+int emit_finish(Emitter * e, FILE * out);
+void emit_discard(Emitter * e);
+void emit_reset(Emitter * e);
+void emit_free(Emitter * e);
+
+/*
+ * Image offset of the next byte emitted, i.e. the location counter.
+ */
+static inline long emit_tell(const Emitter * e) {
+    return e->base + e->ptr;
+}
+
+/*
+ * Make sure there is room for `n` more bytes. Returns 0 on success.
+ */
+static inline int emit_reserve(Emitter * e, long n) {
+    return (e->ptr + n <= e->cap) ? 0 : emit_grow(e, n);
+}
+
+static inline int emit_bytes(Emitter * e, const void * bytes, long n) {
+    if (emit_reserve(e, n)) return 1;
+    memcpy(e->buf + e->ptr, bytes, n);
+    e->ptr += n;
+    return 0;
+}
+
+static inline int emit_u8(Emitter * e, int byte) {
+    if (emit_reserve(e, 1)) return 1;
+    e->buf[e->ptr++] = (char) byte;
+    return 0;
+}
+
+/* words are stored in host byte order, like the rest of the image */
+static inline int emit_u32(Emitter * e, int word) {
+    return emit_bytes(e, &word, sizeof(word));
+}
+
+#endif
@@ -1,278 +1,165 @@
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-#include "debug.h"
+#include "Trace.h"
+#include "Context.h"
 #include "Instruction.h"
 #include "InstructionList.h"
+#include "IsaTables.h"
+#include "Labels.h"
 
-/* list of instructions */
-char * instrBuffer;
-long instrPtr;
-long instrCap;
-
-int getInstrInfo(const char * name, struct InstrRecord * outRecord) {
-    const struct InstrRecord * record = instrLookup;
-    char upper[BUFSIZ];
-    int i = 0;
-
-    /* convert to uppercase for comparison */
-    strcpy(upper, name);
-    while (upper[i] != '\0') {
-        upper[i] = toupper(upper[i]);
-        i++;
-    }
-
-    /* loop through table, comparing names [yes this is O(n)...] */
-    while (record->name != NULL) {
-
-        if (0 == strcmp(upper, record->name)) {
-            if (outRecord != NULL) *outRecord = *record;
-            return 1; /* success */
-        }
-
-        record++; /* move to next record */
-    }
+/*
+ * An operand's entry in isaOperand[]: its form, and its encoded offset.
+ */
+static inline int operandEntry(const struct Operand * op) {
+    unsigned index = op->offset + ISA_OFFSET_MAX;
 
-    /* if not found, zero */
-    return 0;
+    if (index > ISA_OFFSETS) index = ISA_OFFSETS;
+    return isaOperand[op->type][op->size == OPSZ_SHORT][index];
 }
 
-int isInstruction(const char * name) {
-    return getInstrInfo(name, NULL);
-}
+#define FORM(entry) ((entry) & ((1 << ISA_CODE_SHIFT) - 1))
+#define CODE(entry) ((entry) >> ISA_CODE_SHIFT)
 
-int instructionSizeAgreement(struct Instruction * instr) {
-    struct Operand * op1 = &instr->op1;
-    struct Operand * op2 = &instr->op2;
-    int result;
+/*
+ * Does a [register + offset] operand need its offset in a word of its own?
+ */
+int hasCustomOffset(const struct Operand * op) {
+    return FORM(operandEntry(op)) == OF_CUSTOM;
+}
 
-    /* don't need to do size agreement for no-op, one-op */
-    if (instr->type == IT_N ||
-        instr->type == IT_P ||
-        instr->type == IT_U ||
-        instr->type == IT_T) {
-        return 1;
+/*
+ * Look up an instruction's prototype and operands in isaCheck[], and give the
+ * operands the sizes they agree on. Returns IC_OK or what disagreed.
+ */
+static int checkForm(struct Instruction * instr) {
+    int size = isaSizeCode[(int) instr->size];
+    int entry = isaCheck[instr->type][ISA_CLASS(&instr->op1)]
+                        [ISA_CLASS(&instr->op2)][size];
+
+    if (ISA_VERDICT(entry) == IC_OK) {
+        instr->op1.size = isaSizeOf[entry >> ISA_SIZE1_SHIFT & 3];
+        instr->op2.size = isaSizeOf[entry >> ISA_SIZE2_SHIFT & 3];
     }
+    return ISA_VERDICT(entry);
+}
 
-    /* "widen/narrow" operands if needed */
-    if (op1->size != op2->size) {
-        if (instr->size != 0) {
-            DEBUG("  Matching indirect op to size %d", instr->size);
-            if (op1->type == OT_REG_ACCESS || op1->type == OT_REG_OFFSET)
-                op1->size = instr->size;
-            if (op2->type == OT_REG_ACCESS || op2->type == OT_REG_OFFSET)
-                op2->size = instr->size;
-        }
-
-        if (op1->type == OT_CONST) op1->size = op2->size;
-        else if (op2->type == OT_CONST) op2->size = op1->size;;
+/*
+ * Everything an instruction goes through between having its operands and
+ * being saved, whether it came from text or from the structured API. A
+ * mnemonic with two forms (CMP and TEST, whose operand types are reversed)
+ * takes the second when only that one fits. Returns IC_OK, or what disagreed.
+ */
+int checkInstruction(struct Instruction * instr) {
+    struct Instruction other;
+    int verdict, alternate = isaOpcodes[instr->opcode].alternate;
+
+    TRACE_TEXT(TR_CHECK, instr->name, strlen(instr->name), instr->type,
+               instr->op1.size, instr->op2.size, 0);
+
+    verdict = checkForm(instr);
+    if (verdict == IC_OK || alternate == -1) return verdict;
+
+    /* a rejected instruction is left as it was, so try the other form */
+    other = *instr;
+    other.opcode = alternate;
+    other.type = instrLookup[isaOpcodes[alternate].record].type;
+    if (checkForm(&other) == IC_OK) {
+        *instr = other;
+        verdict = IC_OK;
     }
 
-    /* test that both sizes are the same */
-    result = (op1->size == op2->size);
-
-    /* if size is forced, check that the sizes agree with the forced size */
-    if (instr->size != 0)
-        result = (result && instr->size == op1->size);
-
-    return result;
+    return verdict;
 }
 
-int instructionTypeAgreement(struct Instruction * instr) {
-    struct Operand * op1 = &instr->op1;
-    struct Operand * op2 = &instr->op2;
-
-    /* check that the operands' sizes and types agree
-     * with the instruction's prototype */
-    switch (instr->type) {
-
-        case IT_N: /* no operands */
-            return op1->size == 0 && op2->size == 0;
-
-        case IT_A:
-            return op1->size != 0
-                && op2->size != 0
-                && op2->type != OT_CONST;
-
-        case IT_B:
-            return op1->size != 0
-                && op2->size != 0
-                && op1->type != OT_CONST;
-
-        case IT_X:
-            return op1->size != 0
-                && op2->size != 0
-                && op1->type != OT_CONST
-                && op2->type != OT_CONST;
-
-        case IT_I:
-            return op1->size != 0
-                && op2->size != 0
-                && op1->type == OT_CONST
-                && op2->type != OT_CONST;
-
-        case IT_P:
-            return op1->size != 0
-                && op2->size == 0
-                && op1->type != OT_CONST;
-
-        case IT_U:
-            return op1->size != 0
-                && op2->size == 0;
-
-        case IT_T:
-            return op1->size != 0
-                && op2->size == 0
-                && op1->type == OT_CONST;
-
-        default:
-            return 0;
-    }
+/*
+ * Number of bytes an instruction takes in the image, known as soon as its
+ * operands are: the instruction word and any extra words. A constant gets a
+ * word of its own whatever its size, so a label's value never changes the
+ * length and references need no relaxing once labels are placed.
+ */
+int instructionLength(const struct Instruction * instr) {
+    return isaLayout[FORM(operandEntry(&instr->op1))]
+                    [FORM(operandEntry(&instr->op2))].words * sizeof(int);
 }
 
-inline int hasCustomOffset(struct Operand * op) {
-    OperandSize size = op->size;
-    int offset = op->offset;
-
-    if (op->type != OT_REG_OFFSET) return 0;
-
-    if (offset < 0)
-        offset = -offset;
-
-    if (size == OPSZ_SHORT) {
-        return offset != 0 &&
-               offset != 1 &&
-               offset != 2 &&
-               offset != 3;
-    } else {
-        return offset != 0 &&
-               offset != 4 &&
-               offset != 8 &&
-               offset != 12;
-    }
+/*
+ * Encode an instruction into `words`: the instruction word, then the constant
+ * or custom offset of each operand that has one. Returns the number of words.
+ * A forward operand's word is left holding the symbol of its label.
+ */
+int encodeInstruction(short opcode, OperandSize size,
+                      const struct Operand * op1, const struct Operand * op2,
+                      int * words) {
+    int e1 = operandEntry(op1), e2 = operandEntry(op2);
+    const struct IsaLayout * l = &isaLayout[FORM(e1)][FORM(e2)];
+    unsigned instruction = opcode;
+
+    /* lay in size and op types */
+    instruction |= size == OPSZ_SHORT ? SIZE_BIT : 0;
+    instruction |= (unsigned) op1->type << TYPE1_OFFSET;
+    instruction |= (unsigned) op2->type << TYPE2_OFFSET;
+
+    /* operands kept in their fields, register then offset code; the masks
+       are empty for operands that get a word instead */
+    instruction |= ((unsigned) (op1->value | CODE(e1) << 4) << OP1_OFFSET)
+                   & -(unsigned) l->field[0];
+    instruction |= ((unsigned) (op2->value | CODE(e2) << 4) << OP2_OFFSET)
+                   & -(unsigned) l->field[1];
+
+    /* the rest in succeeding words; without one, an operand's store lands in
+       words[0], which is written last */
+    words[l->extra[0]] = l->offset[0] ? op1->offset : op1->value;
+    words[l->extra[1]] = l->offset[1] ? op2->offset : op2->value;
+    words[0] = instruction;
+
+    return l->words;
 }
 
-/* returns the converted 3-bit special offset */
-static char bitOffset(int offset) {
-    switch (offset) {
-        case 0: return R_OFF_0;
-
-        case 1:
-        case 4: return R_OFF_1_4;
-
-        case 2:
-        case 8: return R_OFF_2_8;
-
-        case 3:
-        case 12: return R_OFF_3_12;
-
-        case -3:
-        case -12: return R_NOFF_3_12;
-
-        case -2:
-        case -8: return R_NOFF_2_8;
+/*
+ * Encode an instruction and append it to the image. A reference to a label
+ * gets the label's location, or if it has none yet a link in its fixup chain.
+ */
+int emitInstruction(JasContext * ctx, short opcode, OperandSize size,
+                    const struct Operand * op1, const struct Operand * op2) {
+    int words[3];    /* the instruction word, then any extra words */
+    int nwords = encodeInstruction(opcode, size, op1, op2, words);
+    long at = emit_tell(&ctx->emit); /* where words[0] will land in the image */
+
+    /* a label is a constant, so its word is the operand's first extra one;
+       op2's comes last */
+    if (op1->forward)
+        words[1] = linkFixup(ctx, op1->value, at + sizeof(int));
+    if (op2->forward)
+        words[nwords - 1] = linkFixup(ctx, op2->value,
+                                      at + (nwords - 1) * sizeof(int));
+
+    /* one capacity check for the whole instruction */
+    if (emit_bytes(&ctx->emit, words, nwords * sizeof(int)))
+        return EXIT_FAILURE;
 
-        case -1:
-        case -4: return R_NOFF_1_4;
+    if (ctx->index_out != NULL
+            && indexInstruction(ctx, at, nwords * sizeof(int)))
+        return EXIT_FAILURE;
 
-        default: return R_OFF_CUSTOM;
-    }
+    return EXIT_SUCCESS;
 }
 
-int saveInstruction(struct Instruction * instr) {
-    int instruction = instr->opcode;
-    int op1_const = 0;
-    int op2_const = 0;
-
-    char * temp;     /* for return from realloc */
-
-    /* lay in size */
-    if (instr->size == OPSZ_SHORT)
-        instruction |= SIZE_BIT;
+int saveInstruction(JasContext * ctx, struct Instruction * instr) {
+    TRACE_TEXT(TR_ENCODE, instr->name, strlen(instr->name),
+               instr->op1.value, instr->op1.offset,
+               instr->op2.value, instr->op2.offset);
 
-    /* lay in op types */
-    struct Operand * op1 = &instr->op1;
-    struct Operand * op2 = &instr->op2;
-
-    instruction |= (op1->type << TYPE1_OFFSET);
-    instruction |= (op2->type << TYPE2_OFFSET);
-
-    DEBUG("  Final: Writing instr %s:0x%x with\n" \
-          "\t  op1 type %d, value %d, offset %d\n" \
-          "\t  op2 type %d, value %d, offset %d",
-           instr->name, instr->opcode,
-           op1->type, op1->value, op1->offset,
-           op2->type, op2->value, op2->offset);
-
-    /* operand 1*/
-    if (op1->type == OT_CONST) {
-
-        op1_const = op1->value; /* if the operand is a constant */
-
-    } else if (op1->type == OT_REG_OFFSET) {
-
-        if (hasCustomOffset(op1)) {
-            op1_const = op1->offset;
-        } else {
-            instruction |= op1->value << OP1_OFFSET;
-            instruction |= bitOffset(op1->offset) << (OP1_OFFSET + 4);
-        }
-
-    } else {
-        instruction |= (op1->value << OP1_OFFSET);
-    }
-
-    /* operand 2 */
-    if (op2->type == OT_CONST) {
-
-        op2_const = op2->value; /* if the operand is a constant */
-
-    } else if (op2->type == OT_REG_OFFSET) {
-
-        if (hasCustomOffset(op2)) {
-            op2_const = op2->offset;
-        } else {
-            instruction |= op2->value << OP2_OFFSET;
-            instruction |= bitOffset(op2->offset) << (OP2_OFFSET + 4);
-        }
-
-    } else {
-        instruction |= (op2->value << OP2_OFFSET);
-    }
-
-    /* TODO: make conditional */
-    /* allocate more space for list if needed */
-    instrCap = instrPtr + 3 * sizeof(int); /* increase capacity */
+    return emitInstruction(ctx, instr->opcode, instr->size,
+                           &instr->op1, &instr->op2);
+}
 
-    /* realloc */
-    temp = (char *) realloc(instrBuffer, instrCap);
-    if (temp == NULL) {
-        fprintf(stderr, "realloc() error.\n");
+int writeInstructions(JasContext * ctx, FILE * stream) {
+    /* while streaming most of the image is out already, this is the rest */
+    if (emit_finish(&ctx->emit, stream)) {
+        fprintf(ctx->diag, "error: Could not write output.\n");
         return EXIT_FAILURE;
     }
-    instrBuffer = temp;
-
-    /* add instruction to buffer */
-    memcpy(instrBuffer + instrPtr, &instruction, sizeof(instruction));
-    instrPtr += sizeof(instruction);
-
-    /* include any custom offsets/constants in succeeding word */
-    if (op1->type == OT_CONST || hasCustomOffset(op1)) {
-        memcpy(instrBuffer + instrPtr, &op1_const, sizeof(op1_const));
-        instrPtr += sizeof(op1_const);
-    }
-    if (op2->type == OT_CONST || hasCustomOffset(op2)) {
-        memcpy(instrBuffer + instrPtr, &op2_const, sizeof(op2_const));
-        instrPtr += sizeof(op2_const);
-    }
-
     return EXIT_SUCCESS;
 }
-
-int writeInstructions(FILE * stream) {
-    fwrite(instrBuffer, sizeof(char), instrPtr, stream);
-    return EXIT_SUCCESS; /* TODO: may not be successful? */
-}
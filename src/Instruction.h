@@ -45,6 +45,7 @@ struct Operand {
     enum OperandSize size;
     int value;  /* the value of the register                           */
     int offset; /* how much of an offset, use dependent on OperandType */
+    char forward; /* value is the symbol of a label not yet defined    */
 };
 
 /* Special offsets for indirect access */
@@ -94,25 +95,90 @@ struct InstrRecord{
 #define OP1_OFFSET   18
 #define OP2_OFFSET   25
 
+/* outcomes of checkInstruction() */
+enum InstructionCheck {
+    IC_OK,
+    IC_BAD_SIZE,   /* operands' sizes are not in agreement    */
+    IC_BAD_TYPE    /* operands do not agree with the prototype */
+};
+
+/** ISA tables, generated from Isa.def by mkisa **/
+/*
+ * An operand's class is its type and size, which is all checkInstruction()
+ * needs to know of it: isaCheck[type][class1][class2][forced size] holds the
+ * verdict and the operands' sizes once they agree.
+ */
+#define ISA_TYPES   8           /* enum InstructionType                  */
+#define ISA_SIZES   3           /* size codes: indeterminate, short, long */
+#define ISA_CLASSES (4 * ISA_SIZES)
+#define ISA_OPCODES 512         /* an opcode is at most 9 bits            */
+
+#define ISA_CLASS(op) ((op)->type * ISA_SIZES + isaSizeCode[(op)->size])
+
+/* fields of an isaCheck entry */
+#define ISA_VERDICT(e)  ((e) & 3)
+#define ISA_SIZE1_SHIFT 2
+#define ISA_SIZE2_SHIFT 4
+
+/*
+ * An operand's form is how it is encoded: its type, or OF_CUSTOM for a
+ * [register + offset] whose offset needs a word of its own. A pair of forms
+ * fixes the layout of the whole instruction.
+ */
+#define ISA_FORMS 5
+#define OF_CUSTOM 4
+
+struct IsaLayout {
+    unsigned char words;     /* instruction word and extra words          */
+    unsigned char field[2];  /* operand goes in its field of the first    */
+    unsigned char extra[2];  /* index of the operand's extra word, or 0   */
+    unsigned char offset[2]; /* that word holds its offset, not its value */
+};
+
+/*
+ * isaOperand[type][short][offset index] gives an operand's form, and for a
+ * [register + offset] the code of its offset if that fits in its field. Only
+ * offsets within +/-ISA_OFFSET_MAX can; any other has the last index.
+ */
+#define ISA_OFFSET_MAX 12
+#define ISA_OFFSETS    (2 * ISA_OFFSET_MAX + 1)
+#define ISA_CODE_SHIFT 3
+
+/* each opcode's mnemonic, and the other form of the mnemonic if it has one */
+struct IsaOpcode {
+    short record;            /* index in instrLookup[], -1 if unused      */
+    short alternate;         /* opcode of the mnemonic's other form or -1 */
+    short primary;           /* opcode of its first form, which the
+                                mnemonic's name finds in the text         */
+};
+
 /** Extern declarations **/
 /* mnemonics table */
 extern const struct InstrRecord instrLookup[];
 
-/* instructions list */
-extern char * instrBuffer; /* use this to write directly to file */
-extern long instrPtr; /* points to next available (byte) space in the buffer */
-extern long instrCap;
+extern const unsigned char isaSizeCode[OPSZ_LONG + 1];
+extern const OperandSize isaSizeOf[ISA_SIZES];
+extern const unsigned char isaArity[ISA_TYPES];
+extern const unsigned char
+    isaCheck[ISA_TYPES][ISA_CLASSES][ISA_CLASSES][ISA_SIZES];
+extern const struct IsaLayout isaLayout[ISA_FORMS][ISA_FORMS];
+extern const unsigned char isaOperand[4][2][ISA_OFFSETS + 1];
+extern const struct IsaOpcode isaOpcodes[ISA_OPCODES];
 
 /** function prototypes **/
-/* looking up instructions */
-int getInstrInfo(const char * name, struct InstrRecord * out);
-int isInstruction(const char * name);
-int hasCustomOffset(struct Operand * op);
+/* looking up instructions (mnemonics are looked up through Keywords.h) */
+int hasCustomOffset(const struct Operand * op);
 
 /* saving and writing instructions */
-int saveInstruction(struct Instruction * instr);
-int instructionSizeAgreement(struct Instruction * instr);
-int instructionTypeAgreement(struct Instruction * instr);
-int writeInstructions(FILE * stream);
+struct JasContext;
+int saveInstruction(struct JasContext * ctx, struct Instruction * instr);
+int instructionLength(const struct Instruction * instr);
+int encodeInstruction(short opcode, OperandSize size,
+                      const struct Operand * op1, const struct Operand * op2,
+                      int * words);
+int emitInstruction(struct JasContext * ctx, short opcode, OperandSize size,
+                    const struct Operand * op1, const struct Operand * op2);
+int checkInstruction(struct Instruction * instr);
+int writeInstructions(struct JasContext * ctx, FILE * stream);
 
 #endif
@@ -5,11 +5,59 @@
 "Usage: %s [option...] [file...]\n\n" \
 "Options:\n" \
 "-h, --help\tShow this help message and exit\n" \
-"-o OBJFILE\tName the object-file output OBJFILE (default a.out)\n" \
-"-D\t\tProduce assembler debugging messages\n" \
+"-o OBJFILE\tName the object-file output OBJFILE (default a.out);\n" \
+"\t\twith several inputs, the directory to put each FILE.o in\n" \
+"-D\t\tTrace the assembler and print the trace when done\n" \
+"-O\t\tApply peephole rules before encoding, and report what\n" \
+"\t\tthey saved\n" \
+"--max-memory BYTES\n" \
+"\t\tCap the memory used for labels and other assembler data\n" \
+"--max-errors N\tStop after reporting N errors\n" \
+"-j N\t\tAssemble N files at a time, or a single large file in\n" \
+"\t\tN pieces at once\n" \
+"--manifest LIST\tAlso assemble the files listed in LIST, one per line,\n" \
+"\t\teach optionally followed by its output name\n" \
+"--pipeline\tLex on a thread of its own, ahead of the parser\n" \
+"--io MODE\tRead and write the files in groups, with `uring' or\n" \
+"\t\t`blocking' calls, and report the system calls made\n" \
+"--index\t\tAlso write where each instruction starts, as OBJFILE.idx\n" \
+"--time-report\tReport the time spent in each phase, what was counted\n" \
+"\t\tand the peak memory\n" \
+"--stats-json FILE\n" \
+"\t\tWrite the same as JSON to FILE, `-' for stdout\n" \
+"--trace FILE\tTrace the assembler and save the trace to FILE, for\n" \
+"\t\t`jtrace' to decode\n" \
 "\n"
 
 #define STR_FILE_ERR "ERROR: Could not open file `%s' for reading, no" \
                      " such file or directory.\n"
 
+#define STR_BAD_IO "ERROR: Unknown I/O mode `%s', expecting `uring' or" \
+                   " `blocking'.\n"
+
+#define STR_BAD_NUMBER "ERROR: Invalid value `%s' for %s.\n"
+
+#define STR_IO_REPORT "I/O: %s, %ld files in %ld group(s), %ld system calls," \
+                      " %.3f ms\n"
+
+#define STR_IO_STDIO "I/O: stdio, %ld files, system calls not counted," \
+                     " %.3f ms\n"
+
+#define STR_TIME_HEAD "Time report: %ld file(s), %.3f ms wall; phases summed" \
+                      " over files and threads:\n"
+
+#define STR_TIME_PHASE "  %-8s %10.3f ms %6.1f%%\n"
+
+#define STR_TIME_COUNTS "Counts: %ld tokens, %ld lines, %ld labels," \
+                        " %ld forward fixups, %ld reallocs, %ld bytes" \
+                        " emitted\n"
+
+#define STR_TIME_MEMORY "Peak memory: %.1f MB resident, %.1f MB largest arena\n"
+
+#define STR_PEEPHOLE "Peephole: %ld instructions and %ld bytes saved.\n"
+
+#define STR_NO_TRACE "warning: Tracing is not built in, see src/Trace.h.\n"
+
+#define STR_OUT_ERR "ERROR: Could not open file `%s' for writing.\n"
+
 #endif
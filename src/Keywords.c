@@ -0,0 +1,28 @@
+#include <stddef.h>
+
+#include "Keywords.h"
+#include "KeywordTable.h" /* generated by mkkeywords */
+
+/*
+ * Classify an identifier given as a span of `len` chars.
+ * Returns its keyword entry, or NULL if it is not a keyword.
+ */
+const struct Keyword * findKeyword(const char * s, int len) {
+    unsigned h = kwHash(s, len);
+    const struct Keyword * kw = &kwTable[kwSlot(h, kwDisp[kwBucket(h)])];
+    int i;
+
+    if (kw->kind == KW_NONE || kw->len != len)
+        return NULL;
+
+    /* exact up to `fold`, then case-insensitive; identifier characters only
+     * collide under `| 0x20' when they are the same letter */
+    for (i = 0; i < kw->fold && i < len; i++) {
+        if (s[i] != kw->name[i]) return NULL;
+    }
+    for (; i < len; i++) {
+        if ((s[i] | 0x20) != (kw->name[i] | 0x20)) return NULL;
+    }
+
+    return kw;
+}
@@ -0,0 +1,64 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+/*
+ * Keyword lookup for the lexer
+ * ----------------------------
+ *
+ * Every mnemonic, data directive and register name lives in one perfect hash
+ * table, generated at build time by mkkeywords into KeywordTable.h. A single
+ * probe classifies an identifier and hands back its decoded value.
+ *
+ * The hash folds case, so `MOV', `mov' and `Mov' land in the same slot; each
+ * entry says from which character on case may differ (mnemonics fold all of
+ * it, directives all but the leading `d', registers none).
+ */
+
+/* table geometry: first-level buckets pick a displacement into the slots */
+#define KW_BUCKETS 64
+#define KW_SLOTS   256
+
+/* what kind of keyword an entry is */
+enum KeywordKind {
+    KW_NONE,      /* empty slot                     */
+    KW_INSTR,     /* value: index into instrLookup  */
+    KW_DIRECTIVE, /* value: directive kind, e.g 'b' */
+    KW_GL_REG,    /* value: RegisterId              */
+    KW_GS_REG,
+    KW_E_REG,
+    KW_K_REG
+};
+
+struct Keyword {
+    const char * name;  /* canonical spelling             */
+    unsigned char len;
+    unsigned char fold; /* chars from here on fold case   */
+    unsigned char kind; /* enum KeywordKind               */
+    short value;
+};
+
+/* FNV-1a over the case-folded bytes */
+static inline unsigned kwHash(const char * s, int len) {
+    unsigned h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++)
+        h = (h ^ (unsigned char) (s[i] | 0x20)) * 16777619u;
+    return h;
+}
+
+static inline unsigned kwBucket(unsigned h) {
+    return (h ^ (h >> 15)) & (KW_BUCKETS - 1);
+}
+
+/* mix the hash with a bucket's displacement to pick the final slot */
+static inline unsigned kwSlot(unsigned h, unsigned disp) {
+    h ^= disp * 0x9E3779B9u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h & (KW_SLOTS - 1);
+}
+
+/** function prototypes **/
+const struct Keyword * findKeyword(const char * s, int len);
+
+#endif
@@ -2,89 +2,280 @@
 #include <string.h>
 #include <stdio.h>
 
-#include "debug.h"
-#include "Instruction.h"
+#include "Trace.h"
+#include "Context.h"
 #include "Labels.h"
 
-/* symbol table */
-static LabelRec * symTab;
-static UndefLabel * undefLabels;
-static long numlabels = 0;
-static int numundef = 0;
+static void printUnresolved(JasContext * ctx, const char * label, int len) {
+    fprintf(ctx->diag, "error: Unresolved label `%.*s'\n", len, label);
+}
+
+/* FNV-1a, case-sensitive */
+static unsigned hashLabel(const char * label, int len) {
+    unsigned h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++)
+        h = (h ^ (unsigned char) label[i]) * 16777619u;
+    return h;
+}
+
+/*
+ * Double the index (or create it) and re-insert every record.
+ * Returns 0 on success.
+ */
+static int growIndex(JasContext * ctx) {
+    SymbolTable * st = &ctx->labels;
+    unsigned long size = st->mask ? (st->mask + 1) * 2 : LABEL_INDEX_MIN;
+    unsigned long slot;
+    int * temp;
+    long i;
+
+    /* the old index is left in the arena, the sizes sum to less than this */
+    temp = (int *) arenaAlloc(&ctx->arena, size * sizeof(int));
+    if (temp == NULL) return 1;
+    memset(temp, -1, size * sizeof(int));
 
-static void printUnresolved(const char * label) {
-    fprintf(stderr, "error: Unresolved label `%s'\n", label);
+    st->index = temp;
+    st->mask = size - 1;
+
+    for (i = 0; i < st->num; i++) {
+        slot = st->tab[i].hash & st->mask;
+        while (st->index[slot] != -1) slot = (slot + 1) & st->mask;
+        st->index[slot] = i;
+    }
+
+    return 0;
 }
 
-void resolveLabels(void) {
-    int index, value;
-    for (index = 0; index < numundef; index++) {
-        UndefLabel undef = undefLabels[index];
-        value = getLabelLocation(undef.label);
+/*
+ * Find the record for a label, interning it (undefined) if it isn't there yet.
+ * Returns its index in the table, or -1 if out of memory.
+ */
+long internLabel(JasContext * ctx, const char * label, int len) {
+    SymbolTable * st = &ctx->labels;
+    unsigned h = hashLabel(label, len);
+    unsigned long slot;
+    LabelRec * rec;
+    int i;
+
+    /* keep the load factor at or below 1/2 */
+    if (2 * (st->num + 1) > (long) (st->mask + 1) && growIndex(ctx))
+        return -1;
+
+    for (slot = h & st->mask; (i = st->index[slot]) != -1;
+         slot = (slot + 1) & st->mask) {
+        rec = &st->tab[i];
+        if (rec->hash == h && rec->len == len
+                && 0 == memcmp(rec->label, label, len))
+            return i;
+    }
+
+    /* not found: append a new record, doubling the array when full */
+    if (st->num == st->cap) {
+        long cap = st->cap ? st->cap * 2 : LABEL_INDEX_MIN / 2;
+        LabelRec * temp = (LabelRec *) arenaGrow(&ctx->arena, st->tab,
+                st->cap * sizeof(LabelRec), cap * sizeof(LabelRec));
+        if (temp == NULL) return -1;
+        st->tab = temp;
+        st->cap = cap;
+    }
+
+    if (st->ownNames) {
+        char * copy = (char *) arenaAlloc(&ctx->arena, len);
+        if (copy == NULL) return -1;
+        label = memcpy(copy, label, len);
+    }
+
+    rec = &st->tab[st->num];
+    rec->label = label;
+    rec->len = len;
+    rec->hash = h;
+    rec->location = -1;
+    rec->chain = -1;
+    st->index[slot] = st->num;
 
-        /* resolve dat label */
-        memcpy(instrBuffer + undef.valueptr, &value, sizeof(value));
+    return st->num++;
+}
+
+/*
+ * Patch every placeholder on a fixup chain with `value`.
+ * Returns 0 on success.
+ */
+static int patchChain(JasContext * ctx, int at, int value) {
+    int next;
 
-        if (value < 0) {
-            printUnresolved(undef.label);
-            continue;
+    while (at != -1) {
+        if (emit_peek_u32(&ctx->emit, at, &next)
+                || emit_patch_u32(&ctx->emit, at, value)) {
+            ctx->err = 1;
+            return 1;
         }
+        at = next;
+    }
+    return 0;
+}
+
+/*
+ * Report the labels still undefined now that the whole input has been seen,
+ * and fill in their references with -1. A label referred to only by rejected
+ * instructions has no references left, but is reported all the same.
+ */
+void resolveLabels(JasContext * ctx) {
+    SymbolTable * st = &ctx->labels;
+    long index;
+
+    /* a deferred table is resolved by whoever merges it */
+    if (st->defer) return;
 
-        free(undef.label); /* no need for this string anymore */
+    for (index = 0; index < st->num; index++) {
+        LabelRec * rec = &st->tab[index];
+
+        if (rec->location != -1) continue;
+
+        printUnresolved(ctx, rec->label, rec->len);
+        if (patchChain(ctx, rec->chain, -1)) return;
+        rec->chain = -1;
     }
-    free(undefLabels); /* no need for this list anymore */
 }
 
-void saveLabel(const char * label, int location) {
-    LabelRec newRec;
-    LabelRec * temp;
-    int llen = strlen(label) + 1; // For alloc'ing and copying -- includes nul.
-    char * labelcpy = (char *) malloc(llen);
+/*
+ * Forget every label. The arrays themselves go away with the context's arena.
+ */
+void clearLabels(JasContext * ctx) {
+    SymbolTable * st = &ctx->labels;
+
+    st->tab = NULL;
+    st->num = st->cap = 0;
+    st->index = NULL;
+    st->mask = 0;
+    st->ownNames = 0;
+    st->defer = 0;
+}
+
+/*
+ * Define a label at `location`, patching the references made to it so far.
+ * Returns 0 on success, or -1 if the label was already defined.
+ */
+int saveLabel(JasContext * ctx, const char * label, int len,
+              int location) {
+    SymbolTable * st = &ctx->labels;
+    long sym = internLabel(ctx, label, len);
+    LabelRec * rec;
+
+    if (sym < 0) return 0; /* out of memory, already reported */
+    rec = &st->tab[sym];
 
-    /* allocate more space for table */
-    temp = (LabelRec *) realloc(symTab, sizeof(LabelRec) * (numlabels + 1));
-    if (temp == NULL) { fprintf(stderr, "realloc() error.\n"); return; }
-    symTab = temp;
+    /* the same probe that defines the label tells us about duplicates */
+    if (rec->location != -1)
+        return -1;
 
-    /* load new label insert into table */
-    newRec.label = strncpy(labelcpy, label, llen);
-    newRec.location = location;
-    symTab[numlabels++] = newRec;
+    rec->location = location;
 
-    DEBUG("Symtab[%ld] Inserted `%s', location %d",
-            numlabels - 1, newRec.label, newRec.location);
+    TRACE_TEXT(TR_LABEL, label, len, sym, location, 0, 0);
+
+    if (!st->defer) {
+        patchChain(ctx, rec->chain, location);
+        rec->chain = -1;
+    }
+    return 0;
 }
 
-void saveUndefLabel(const char * label, long valueptr) {
-    UndefLabel newLabel;
-    UndefLabel * temp;
-    char * labelcpy = (char *) malloc(strlen(label));
+/*
+ * Look up a label used as an operand. Returns its location, or -1 if it is
+ * not defined yet; then `*sym` is the record to chain the reference onto with
+ * linkFixup(), or -1 if out of memory. Retained statements are only placed
+ * when encoded, so while retaining every reference is left to linkFixup().
+ */
+int referLabel(JasContext * ctx, const char * label, int len, int * sym) {
+    SymbolTable * st = &ctx->labels;
+    long i = internLabel(ctx, label, len);
 
-    strncpy(labelcpy, label, strlen(label));
-    labelcpy[strlen(label)] = '\0'; /* null terminate */
+    *sym = -1;
+    if (i < 0) return -1;
 
-    /* populate entry */
-    newLabel.label = labelcpy;
-    newLabel.valueptr = valueptr;
+    if (st->defer || ctx->retain || st->tab[i].location == -1) {
+        *sym = i;
+        return -1;
+    }
+    return st->tab[i].location;
+}
 
-    temp = (UndefLabel *) realloc(undefLabels, sizeof(UndefLabel) * (numundef + 1));
-    if (temp == NULL) { fprintf(stderr, "realloc() error.\n"); return; }
-    undefLabels = temp;
+/*
+ * Make the placeholder at image offset `at` the newest reference to label
+ * `sym`. Returns the word to store in it: the link to the previous one, or
+ * the label's location if it has been defined since it was referred to.
+ */
+int linkFixup(JasContext * ctx, int sym, long at) {
+    SymbolTable * st = &ctx->labels;
+    int prev = st->tab[sym].chain;
 
-    undefLabels[numundef++] = newLabel;
+    if (st->tab[sym].location != -1 && !st->defer)
+        return st->tab[sym].location;
 
-    DEBUG("undefLabels[%d] Inserted `%s'",
-            numundef - 1, newLabel.label);
+    st->tab[sym].chain = (int) at;
+    ctx->stats.fixups++;
+    return prev;
 }
 
-int getLabelLocation(const char * label) {
-    /* search the array pls */
+/*
+ * Look up a label without interning it. Returns its location, or -1 if it is
+ * unknown or not defined. Safe to call from several threads at once.
+ */
+int findLabel(const JasContext * ctx, const char * label, int len) {
+    const SymbolTable * st = &ctx->labels;
+    unsigned h = hashLabel(label, len);
+    unsigned long slot;
     int i;
-    for (i = 0; i < numlabels; i++) {
-        if (0 == strcmp(symTab[i].label, label)) {
-            return symTab[i].location;
-        }
+
+    if (st->index == NULL) return -1;
+
+    for (slot = h & st->mask; (i = st->index[slot]) != -1;
+         slot = (slot + 1) & st->mask) {
+        const LabelRec * rec = &st->tab[i];
+        if (rec->hash == h && rec->len == len
+                && 0 == memcmp(rec->label, label, len))
+            return rec->location;
     }
 
     return -1;
 }
+
+/*
+ * Define in `ctx` every label `part` defines, moved up by `base`. Returns
+ * nonzero if one was already defined (or memory ran out).
+ */
+int mergeLabels(JasContext * ctx, const JasContext * part, long base) {
+    const SymbolTable * st = &part->labels;
+    long index;
+
+    for (index = 0; index < st->num; index++) {
+        const LabelRec * rec = &st->tab[index];
+
+        if (rec->location == -1) continue;
+        if (saveLabel(ctx, rec->label, rec->len, base + rec->location)
+                || ctx->arena.failed)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Patch each reference chained up in deferred `part` with the location its
+ * label has in `ctx`. Returns nonzero if a label is undefined there.
+ */
+int relocateLabels(JasContext * part, const JasContext * ctx) {
+    SymbolTable * st = &part->labels;
+    long index;
+    int location;
+
+    for (index = 0; index < st->num; index++) {
+        LabelRec * rec = &st->tab[index];
+
+        if (rec->chain == -1) continue;
+        if ((location = findLabel(ctx, rec->label, rec->len)) == -1)
+            return 1;
+        if (patchChain(part, rec->chain, location)) return 1;
+        rec->chain = -1;
+    }
+    return 0;
+}
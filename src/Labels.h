@@ -2,21 +2,62 @@
 #define LABELS_H
 
 /** symbol table infrastructure **/
+/*
+ * Labels are interned: the first span seen for a name (it points into the
+ * source text, which outlives the table) becomes the one copy every later
+ * lookup resolves to. Records live in a dense array, found through an
+ * open-addressing index of record numbers, so growing the index never moves
+ * a record.
+ */
 typedef struct {
-    char * label;
-    int location;
+    const char * label;
+    int len;
+    unsigned hash;
+    int location;       /* -1 until the label is defined */
+    int chain;          /* latest placeholder referring to it, -1 if none */
 } LabelRec;
 
-/* for labels that are undefined, store in a list */
-typedef struct {
-    char * label;
-    long valueptr;
-} UndefLabel;
+/*
+ * Forward references cost no memory of their own: each placeholder word in
+ * the image holds the offset of the previous placeholder for the same label
+ * (-1 ends the chain), and the label's record holds the latest one. Defining
+ * the label walks the chain and patches every link with its location.
+ *
+ * A placeholder is always a whole word: a label is a constant, and constants
+ * take a word of their own at either size (see instructionLength()), so
+ * where a label ends up never changes the size of what refers to it.
+ */
+
+/* the symbol table, one per JasContext; all arrays live in its arena */
+typedef struct SymbolTable {
+    LabelRec * tab;         /* dense array of records                   */
+    long num, cap;
+    int * index;            /* open addressing into tab, -1 = empty     */
+    unsigned long mask;     /* index size - 1                           */
+    int ownNames;           /* copy names into the arena when interning,
+                               for callers whose strings don't outlive us */
+    int defer;              /* keep every reference on its chain, even to
+                               labels already defined (see Chunks.h)      */
+} SymbolTable;
+
+/* the index is grown to keep its load factor at or below 1/2 */
+#define LABEL_INDEX_MIN 1024
+
+struct JasContext;
+
+long internLabel(struct JasContext * ctx, const char * label, int len);
+int saveLabel(struct JasContext * ctx, const char * label, int len,
+              int location);
+int referLabel(struct JasContext * ctx, const char * label, int len,
+               int * sym);
+int linkFixup(struct JasContext * ctx, int sym, long at);
 
-void saveLabel(const char * label, int location);
-int getLabelLocation(const char * label);
+void resolveLabels(struct JasContext * ctx);
+void clearLabels(struct JasContext * ctx);
 
-void saveUndefLabel(const char * label, long valueptr);
-void resolveLabels(void);
+int findLabel(const struct JasContext * ctx, const char * label, int len);
+int mergeLabels(struct JasContext * ctx, const struct JasContext * part,
+                long base);
+int relocateLabels(struct JasContext * part, const struct JasContext * ctx);
 
 #endif
@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include "Trace.h"
+#include "Context.h"
+#include "Instruction.h"
+#include "Keywords.h"
+#include "Peephole.h"
+#include "Statements.h"
+
+/* what an instruction must look like for a rule to match it */
+enum Match {
+    PM_CONST,       /* op1 is the constant `value'                     */
+    PM_CONST_REG,   /* that, and op2 is a register                     */
+    PM_SAME_REG,    /* both operands are the same register             */
+    PM_ANY,         /* anything, the next instruction decides          */
+    PM_NEXT_LABEL   /* op1 is a label defined before the next statement */
+};
+
+/* what it becomes */
+enum Action {
+    PA_UNARY,       /* `to' op2                                        */
+    PA_SELF,        /* `to' op2, op2                                   */
+    PA_MERGE,       /* `to' op1, and the next instruction goes         */
+    PA_DELETE       /* nothing                                         */
+};
+
+struct Rule {
+    const char * from;  /* mnemonic matched                            */
+    int match;          /* enum Match                                  */
+    int value;          /* the constant PM_CONST* look for             */
+    const char * next;  /* mnemonic the next instruction must have     */
+    int action;         /* enum Action                                 */
+    const char * to;    /* mnemonic it becomes                         */
+    int flags;          /* sets flags `from' did not, or not as it did */
+};
+
+static const struct Rule rules[] = {
+    /* from   match          value  next   action     to     flags */
+    {"add",  PM_CONST,       1,    NULL,  PA_UNARY,  "inc", 1},
+    {"add",  PM_CONST,       -1,   NULL,  PA_UNARY,  "dec", 1},
+    {"sub",  PM_CONST,       1,    NULL,  PA_UNARY,  "dec", 1},
+    {"sub",  PM_CONST,       -1,   NULL,  PA_UNARY,  "inc", 1},
+    {"mov",  PM_CONST_REG,   0,    NULL,  PA_SELF,   "xor", 1},
+    {"mov",  PM_SAME_REG,    0,    NULL,  PA_DELETE, NULL,  0},
+    {"call", PM_ANY,         0,    "ret", PA_MERGE,  "jmp", 0},
+    {"jmp",  PM_NEXT_LABEL,  0,    NULL,  PA_DELETE, NULL,  0}
+};
+
+#define NUM_RULES (int) (sizeof(rules) / sizeof(rules[0]))
+
+/*
+ * What instructions do to the flags, as far as flagsDead() is concerned.
+ * Anything not listed might read them.
+ */
+enum Effect {
+    FX_READ,        /* reads them, jumps, or is not known not to       */
+    FX_NONE,        /* leaves them alone                               */
+    FX_WRITE        /* sets all of them without reading any            */
+};
+
+static const char * const writers[] = {
+    "add", "sub", "cmp", "test", "and", "or", "xor", "neg", "lfl"
+};
+static const char * const neutral[] = {
+    "nop", "mov", "pop", "push", "xchg"
+};
+
+/* the tables with mnemonics looked up, for one pass */
+struct Peephole {
+    short from[NUM_RULES], next[NUM_RULES], to[NUM_RULES]; /* -1 if none */
+    unsigned char effect[ISA_OPCODES];                     /* enum Effect */
+};
+
+static short opcodeOf(const char * name) {
+    const struct Keyword * kw;
+
+    if (name == NULL) return -1;
+    kw = findKeyword(name, strlen(name));
+    return (kw && kw->kind == KW_INSTR) ? instrLookup[kw->value].opcode : -1;
+}
+
+/* give a mnemonic's opcodes, both forms of it, an effect */
+static void setEffect(struct Peephole * ph, const char * name, int effect) {
+    short opcode = opcodeOf(name);
+
+    if (opcode == -1) return;
+    ph->effect[opcode] = effect;
+    if (isaOpcodes[opcode].alternate != -1)
+        ph->effect[isaOpcodes[opcode].alternate] = effect;
+}
+
+static void setup(struct Peephole * ph) {
+    int i;
+
+    for (i = 0; i < NUM_RULES; i++) {
+        ph->from[i] = opcodeOf(rules[i].from);
+        ph->next[i] = opcodeOf(rules[i].next);
+        ph->to[i] = opcodeOf(rules[i].to);
+    }
+
+    memset(ph->effect, FX_READ, sizeof(ph->effect));
+    for (i = 0; i < (int) (sizeof(writers) / sizeof(writers[0])); i++)
+        setEffect(ph, writers[i], FX_WRITE);
+    for (i = 0; i < (int) (sizeof(neutral) / sizeof(neutral[0])); i++)
+        setEffect(ph, neutral[i], FX_NONE);
+}
+
+/* the statement after `i' that is still there, or st->num */
+static long following(const Statements * st, long i) {
+    for (i++; i < st->num && st->kind[i] == ST_DELETED; i++) ;
+    return i;
+}
+
+/*
+ * Are the flags as statement `i' leaves them never read? They are if a later
+ * instruction sets them all first, or the program ends first; anything else
+ * in between (a label, data, a jump, too long a wait) and they might be.
+ */
+static int flagsDead(const struct Peephole * ph, const Statements * st,
+                     long i) {
+    int seen = 0;
+
+    for (i = following(st, i); i < st->num; i = following(st, i)) {
+        if (st->kind[i] != ST_INSTR || ++seen > PEEPHOLE_REACH) return 0;
+
+        switch (ph->effect[(int) st->opcode[i]]) {
+            case FX_WRITE: return 1;
+            case FX_READ: return 0;
+        }
+    }
+    return 1;
+}
+
+/* is `op' a label defined between statement `i' and the next one? */
+static int labelledNext(const Statements * st, long i,
+                        const struct Operand * op) {
+    if (op->type != OT_CONST || !op->forward) return 0;
+
+    for (i = following(st, i); i < st->num && st->kind[i] == ST_LABEL;
+         i = following(st, i)) {
+        if (st->value1[i] == op->value) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Try rule `r' on instruction statement `i', whose opcode it is for. Returns
+ * nonzero if it was applied.
+ */
+static int applyRule(const struct Peephole * ph, Statements * st, int r,
+                     long i) {
+    const struct Rule * rule = &rules[r];
+    struct Instruction instr = {0}, out = {0};
+    long next = following(st, i);
+
+    loadInstruction(st, i, &instr);
+
+    switch (rule->match) {
+        case PM_CONST:
+        case PM_CONST_REG:
+            if (instr.op1.type != OT_CONST || instr.op1.forward
+                    || instr.op1.value != rule->value)
+                return 0;
+            if (rule->match == PM_CONST_REG && instr.op2.type != OT_REG)
+                return 0;
+            break;
+
+        case PM_SAME_REG:
+            if (instr.op1.type != OT_REG || instr.op2.type != OT_REG
+                    || instr.op1.value != instr.op2.value)
+                return 0;
+            break;
+
+        case PM_NEXT_LABEL:
+            if (!labelledNext(st, i, &instr.op1)) return 0;
+            break;
+    }
+
+    /* merged with the next instruction, which nothing may jump to */
+    if (ph->next[r] != -1 && (next == st->num || st->kind[next] != ST_INSTR
+                              || st->opcode[next] != ph->next[r]))
+        return 0;
+
+    if (rule->flags && !flagsDead(ph, st, i)) return 0;
+
+    if (rule->action == PA_DELETE) {
+        st->kind[i] = ST_DELETED;
+        return 1;
+    }
+
+    out.name = rule->to;
+    out.opcode = ph->to[r];
+    out.type = instrLookup[isaOpcodes[out.opcode].record].type;
+    out.size = instr.size;
+    switch (rule->action) {
+        case PA_UNARY: out.op1 = instr.op2; break;
+        case PA_SELF:  out.op1 = out.op2 = instr.op2; break;
+        case PA_MERGE: out.op1 = instr.op1; break;
+    }
+
+    if (checkInstruction(&out) != IC_OK) return 0;
+    if (rule->action != PA_MERGE
+            && instructionLength(&out) >= instructionLength(&instr))
+        return 0;
+
+    storeInstruction(st, i, &out);
+    if (rule->action == PA_MERGE) st->kind[next] = ST_DELETED;
+    return 1;
+}
+
+/*
+ * Apply every rule once over the whole program. Returns how many applied.
+ */
+static int peepholePass(const struct Peephole * ph, Statements * st) {
+    long i;
+    int r, applied = 0;
+
+    for (i = 0; i < st->num; i++) {
+        if (st->kind[i] != ST_INSTR) continue;
+
+        for (r = 0; r < NUM_RULES; r++) {
+            if (st->opcode[i] == ph->from[r] && applyRule(ph, st, r, i)) {
+                TRACE_TEXT(TR_PEEPHOLE_RULE, rules[r].from,
+                           strlen(rules[r].from), st->line[i], r, 0, 0);
+                applied++;
+                break;
+            }
+        }
+    }
+    return applied;
+}
+
+/*
+ * Apply the rules over the whole retained program until none applies, or
+ * for PEEPHOLE_PASSES passes, and place what is left. Returns the number of
+ * instructions rewritten or removed.
+ */
+int optimizeStatements(JasContext * ctx) {
+    Statements * st = &ctx->stmts;
+    struct Peephole ph;
+    long i, instrs = 0, addr = st->addr;
+    int passes = 0, applied = 0, n;
+
+    setup(&ph);
+
+    for (i = 0; i < st->num; i++)
+        if (st->kind[i] == ST_INSTR) instrs++;
+
+    /* every rule makes the program smaller, so this ends by itself; the
+       cap bounds the time a pathological source can take */
+    do {
+        n = peepholePass(&ph, st);
+        applied += n;
+        passes++;
+    } while (n && passes < PEEPHOLE_PASSES);
+
+    placeStatements(ctx);
+
+    for (i = 0; i < st->num; i++)
+        if (st->kind[i] == ST_INSTR) instrs--;
+
+    ctx->stats.savedInstrs += instrs;
+    ctx->stats.savedBytes += addr - st->addr;
+    TRACE(TR_PEEPHOLE, applied, passes, instrs, addr - st->addr);
+    return applied;
+}
@@ -0,0 +1,43 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+/*
+ * Peephole rules
+ * --------------
+ *
+ * With a context's `optimize` setting (which needs `retain`, see
+ * Statements.h) the retained program is rewritten before it is encoded, by
+ * a table of rules each matching one instruction and perhaps the one after:
+ *
+ *     add 1, x / sub -1, x      inc x
+ *     sub 1, x / add -1, x      dec x
+ *     mov 0, r                  xor r, r
+ *     mov r, r                  (nothing)
+ *     call x / ret              jmp x
+ *     jmp L / L:                (nothing, falls through to L)
+ *
+ * A rewrite is made only where it is shorter, once checkInstruction() has
+ * accepted it. Those that set flags the original did not are made only where
+ * the flags are certainly dead: overwritten before anything reads them, with
+ * no label, data or jump in between. An instruction with a label in front of
+ * it is never merged into the one before. [reg + offset] operands need no
+ * rule: offsets that fit an offset code are put in the instruction word by
+ * the encoder already.
+ *
+ * One rewrite can make room for another: a call/ret pair that becomes a jmp
+ * to the very next label, say, or a jmp left falling through once a mov r, r
+ * before its label is gone. So the rules are applied over the whole program
+ * pass after pass until none applies, up to PEEPHOLE_PASSES, and only then
+ * are labels placed again.
+ *
+ * What was saved goes into ctx->stats.
+ */
+
+#define PEEPHOLE_REACH  16  /* instructions looked ahead for a flag writer */
+#define PEEPHOLE_PASSES 8   /* passes over the program at most            */
+
+struct JasContext;
+
+/** function prototypes **/
+int optimizeStatements(struct JasContext * ctx);
+
+#endif
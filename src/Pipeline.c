@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L /* open_memstream */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Trace.h"
+#include "Pipeline.h"
+#include "libjas.h"
+#include "parser.h"
+
+#define RING_MASK (TOKEN_RING_SIZE - 1)
+
+/* let the other side run, but only once spinning has not helped */
+static void backOff(int * spins) {
+    if (++*spins == RING_SPIN) {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+/*
+ * Producer: append a token, waiting while the ring is full. Returns nonzero
+ * if the consumer has stopped taking tokens.
+ */
+static int ringPush(TokenRing * ring, const Token * tok) {
+    unsigned long tail = ring->tail;
+    int spins = 0;
+
+    while (tail - ring->headSeen == TOKEN_RING_SIZE) {
+        ring->headSeen = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - ring->headSeen < TOKEN_RING_SIZE) break;
+
+        if (__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE)) return 1;
+        backOff(&spins);
+    }
+
+    ring->slot[tail & RING_MASK] = *tok;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Consumer: take the next token, waiting while the ring is empty. The final
+ * TOK_EOF is left in place, so that it is what every later call sees too, just
+ * as with the lexer itself.
+ */
+Token ringPop(TokenRing * ring) {
+    unsigned long head = ring->head;
+    int spins = 0;
+    Token tok;
+
+    while (head == ring->tailSeen) {
+        ring->tailSeen = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head != ring->tailSeen) break;
+        backOff(&spins);
+    }
+
+    tok = ring->slot[head & RING_MASK];
+    if (tok.type != TOK_EOF)
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return tok;
+}
+
+struct Producer {
+    JasContext * lexer;
+    TokenRing * ring;
+};
+
+static void * produce(void * arg) {
+    struct Producer * p = (struct Producer *) arg;
+    Token tok;
+
+    do {
+        tok = next_tok(p->lexer);
+        if (ringPush(p->ring, &tok)) break;
+    } while (tok.type != TOK_EOF);
+
+    return NULL;
+}
+
+/*
+ * Assemble `len` bytes at `src` with the lexer on a second thread, into ctx's
+ * emitter as set up by the caller. Returns 0 if that went without a single
+ * error. Otherwise returns nonzero having reported nothing; the caller then
+ * takes back whatever was emitted and assembles the source serially.
+ */
+int assemblePipelined(JasContext * ctx, const char * src, size_t len) {
+    struct Producer producer;
+    pthread_t thread;
+    FILE * diag = ctx->diag, * discard;
+    int maxErrors = ctx->max_errors;
+    char * sink = NULL;
+    size_t sinkLen = 0;
+    int failed = 1;
+
+    producer.ring = (TokenRing *) calloc(1, sizeof(TokenRing));
+    producer.lexer = jas_context_new();
+    discard = open_memstream(&sink, &sinkLen);
+    if (producer.ring == NULL || producer.lexer == NULL || discard == NULL)
+        goto done;
+
+    producer.lexer->filename = ctx->filename;
+    producer.lexer->diag = discard;
+    producer.lexer->arena.limit = ctx->arena.limit;
+    producer.lexer->measure = ctx->measure;
+    lex_init(producer.lexer, src, len);
+
+    /* our own lexer only ever finds source lines for diagnostics */
+    lex_init(ctx, src, len);
+    ctx->ring = producer.ring;
+    ctx->diag = discard;
+    ctx->max_errors = 1;
+
+    if (pthread_create(&thread, NULL, produce, &producer)) {
+        ctx->ring = NULL;
+        goto restore;
+    }
+
+    assemble(ctx);
+
+    __atomic_store_n(&producer.ring->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    failed = ctx->err || ctx->arena.failed
+             || producer.lexer->err || producer.lexer->arena.failed;
+    ctx->stats.lex += producer.lexer->stats.lex;
+    TRACE(TR_PIPELINE, failed, 0, 0, 0);
+
+    ctx->ring = NULL;
+restore:
+    ctx->diag = diag;
+    ctx->max_errors = maxErrors;
+done:
+    if (discard != NULL) fclose(discard);
+    free(sink);
+    jas_context_free(producer.lexer);
+    free(producer.ring);
+
+    return failed;
+}
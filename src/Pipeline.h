@@ -0,0 +1,48 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+/*
+ * Pipelined lexing
+ * ----------------
+ *
+ * The lexer runs on a thread of its own, a step ahead of the parser, and hands
+ * over fully decoded tokens (type, span, value and position) through a ring
+ * with one producer and one consumer. Neither side takes a lock: each owns one
+ * index and only reads the other's, caching it until the ring looks full or
+ * empty, so the two cores only share a cache line when one has caught up.
+ *
+ * The lexer thread uses a context of its own, and nothing it would report
+ * reaches the user. If either side finds an error the pipelined attempt is
+ * dropped and the source assembled again on one thread, which reports
+ * everything in the usual order.
+ */
+
+#include <stddef.h>
+
+#include "Context.h"
+
+#define TOKEN_RING_SIZE 4096 /* tokens, a power of two */
+#define CACHE_LINE 64
+
+/* a waiting side spins this many times before it yields the CPU */
+#define RING_SPIN 64
+
+typedef struct TokenRing {
+    /* producer's, read by the consumer */
+    unsigned long tail;
+    unsigned long headSeen;   /* last head the producer read */
+    char padTail[CACHE_LINE - 2 * sizeof(unsigned long)];
+
+    /* consumer's, read by the producer */
+    unsigned long head;
+    unsigned long tailSeen;
+    int stop;                 /* the consumer wants no more tokens */
+    char padHead[CACHE_LINE - 2 * sizeof(unsigned long) - sizeof(int)];
+
+    Token slot[TOKEN_RING_SIZE];
+} TokenRing;
+
+/** function prototypes **/
+Token ringPop(TokenRing * ring);
+int assemblePipelined(JasContext * ctx, const char * src, size_t len);
+
+#endif
@@ -1,6 +1,5 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <errno.h>
 
 #include "Registers.h"
 
@@ -14,28 +13,53 @@ int isShortRegister(char endchar) {
             endchar == 'd');
 }
 
-RegisterId getRegisterId(const char * name) {
+RegisterId getRegisterId(const char * name, int len) {
     RegisterId id = 0;
-    char * endptr;
+    RegisterId num = 0;
+    const char * end = name + len;
 
     /* move 1 byte past the 'r' */
     name = name + 1;
 
     /* check for aliased registers */
-    switch (*name) {
-        case 's': return 15;
-        case 'e': id = 16; name++; break;
-        case 'k': id = 24; name++; break;
+    if (name < end) {
+        switch (*name) {
+            case 's': return 15;
+            case 'e': id = 16; name++; break;
+            case 'k': id = 24; name++; break;
+        }
     }
 
+    /* register number, in decimal */
+    while (name < end && '0' <= *name && *name <= '9')
+        num = num * REG_BASE + (*name++ - '0');
+    id += num;
 
-    errno = 0;
-    id += (RegisterId) strtol(name, &endptr, REG_BASE);
-
-    if (isShortRegister(*endptr)) {
+    if (name < end && isShortRegister(*name)) {
         id *= REG_SIZE;
-        id += (*endptr - 'a') + 1;
+        id += (*name - 'a') + 1;
     }
 
     return id;
 }
+
+/*
+ * The name getRegisterId() turns into `id`, among the short registers if
+ * `isShort` is set and the long ones otherwise. Writes at most 5 bytes to
+ * `name`. Returns 0 if no register of that size has the id.
+ */
+int getRegisterName(RegisterId id, int isShort, char * name) {
+    if (isShort) {
+        if (id < 1 || id > 16 * REG_SIZE) return 0;
+        sprintf(name, "r%d%c", (id - 1) / REG_SIZE, 'a' + (id - 1) % REG_SIZE);
+    } else if (id < 16) {
+        sprintf(name, "r%d", id);
+    } else if (id < 23) {
+        sprintf(name, "re%d", id - 16);
+    } else if (id >= 24 && id < 32) {
+        sprintf(name, "rk%d", id - 24);
+    } else {
+        return 0;
+    }
+    return 1;
+}
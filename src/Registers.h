@@ -4,6 +4,7 @@
 typedef unsigned char RegisterId;
 
 int isShortRegister(char);
-RegisterId getRegisterId(const char *);
+RegisterId getRegisterId(const char *, int);
+int getRegisterName(RegisterId, int, char *);
 
 #endif
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "Trace.h"
+#include "Source.h"
+
+/*
+ * Map a regular file into memory. Returns 0 on success, nonzero if the file
+ * cannot be mapped (in which case the caller should fall back to reading).
+ */
+static int mapSource(struct Source * src, FILE * stream) {
+    struct stat st;
+    long start;
+    void * map;
+
+    if (fstat(fileno(stream), &st) != 0 || !S_ISREG(st.st_mode))
+        return 1;
+
+    /* the stream may already have been read from, so skip what was consumed */
+    start = ftell(stream);
+    if (start < 0 || st.st_size <= start)
+        return 1;
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(stream), 0);
+    if (map == MAP_FAILED)
+        return 1;
+
+    /* the lexer walks the file front to back exactly once */
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    src->data = (const char *) map + start;
+    src->len = st.st_size - start;
+    src->cap = st.st_size; /* remembered for munmap */
+    src->mapped = 1;
+
+    TRACE(TR_SOURCE_MAP, src->len, 0, 0, 0);
+    return 0;
+}
+
+/*
+ * Read the whole stream into a growable buffer, doubling on each fill.
+ */
+static int readSource(struct Source * src, FILE * stream) {
+    char * buf = NULL;
+    char * temp;
+    size_t len = 0, cap = 0, got;
+
+    do {
+        if (len == cap) {
+            cap = cap ? cap * 2 : SOURCE_CHUNK;
+            temp = (char *) realloc(buf, cap);
+            if (temp == NULL) {
+                fprintf(stderr, "realloc() error.\n");
+                free(buf);
+                return 1;
+            }
+            buf = temp;
+        }
+
+        got = fread(buf + len, 1, cap - len, stream);
+        len += got;
+    } while (got > 0);
+
+    if (ferror(stream)) {
+        free(buf);
+        return 1;
+    }
+
+    src->data = buf;
+    src->len = len;
+    src->cap = cap;
+    src->mapped = 0;
+
+    TRACE(TR_SOURCE_READ, src->len, 0, 0, 0);
+    return 0;
+}
+
+/*
+ * Load all of `stream` into `src`. Returns 0 on success.
+ */
+int loadSource(struct Source * src, FILE * stream) {
+    if (mapSource(src, stream) == 0)
+        return 0;
+
+    return readSource(src, stream);
+}
+
+void freeSource(struct Source * src) {
+    if (src->mapped) {
+        /* `data` may be offset into the mapping, cap holds its full length */
+        const char * base = src->data + src->len - src->cap;
+        munmap((void *) base, src->cap);
+    } else {
+        free((void *) src->data);
+    }
+
+    src->data = NULL;
+    src->len = src->cap = 0;
+    src->mapped = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * An assembly source held entirely in memory, so that the lexer can walk a
+ * plain pointer instead of pulling characters through stdio.
+ *
+ * Regular files are mmap'd; anything else (stdin, pipes, sockets) is read in
+ * chunks into a buffer that doubles as it fills.
+ */
+struct Source {
+    const char * data; /* first byte of the source text                 */
+    size_t len;        /* number of bytes in the source text            */
+    size_t cap;        /* capacity of the read buffer, or when mmap'd
+                          the length of the whole mapping, for munmap  */
+    int mapped;        /* nonzero if `data` is a mapping to be munmap'd */
+};
+
+/* first read is this big, later reads double the buffer */
+#define SOURCE_CHUNK 65536
+
+/** function prototypes **/
+int loadSource(struct Source * src, FILE * stream);
+void freeSource(struct Source * src);
+
+#endif
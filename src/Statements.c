@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "Trace.h"
+#include "Context.h"
+#include "Instruction.h"
+#include "Statements.h"
+
+/*
+ * Make room for one more statement, growing every array together.
+ * Returns 0 on success.
+ */
+static int growStatements(JasContext * ctx) {
+    Statements * st = &ctx->stmts;
+    long cap = st->cap ? st->cap * 2 : STATEMENTS_MIN;
+    void * tmp;
+
+    if (st->num < st->cap) return 0;
+
+#define GROW(field) \
+    do { \
+        tmp = arenaGrow(&ctx->arena, st->field, st->cap * sizeof(*st->field), \
+                        cap * sizeof(*st->field)); \
+        if (tmp == NULL) return 1; \
+        st->field = tmp; \
+    } while (0)
+
+    GROW(kind);
+    GROW(type);
+    GROW(size);
+    GROW(opSize);
+    GROW(opKind);
+    GROW(opcode);
+    GROW(value1);
+    GROW(offset1);
+    GROW(value2);
+    GROW(offset2);
+    GROW(line);
+#undef GROW
+
+    st->cap = cap;
+    return 0;
+}
+
+/*
+ * Append a statement of `kind`, returning its index or -1 if out of memory.
+ * Only its kind and line are filled in.
+ */
+static long addStatement(JasContext * ctx, int kind, int line) {
+    Statements * st = &ctx->stmts;
+
+    if (growStatements(ctx)) return -1;
+
+    st->kind[st->num] = kind;
+    st->line[st->num] = line;
+    return st->num++;
+}
+
+/*
+ * Write instruction statement `i`'s columns from `instr`.
+ */
+void storeInstruction(Statements * st, long i,
+                      const struct Instruction * instr) {
+    st->type[i] = instr->type;
+    st->size[i] = instr->size;
+    st->opSize[i] = instr->op1.size | instr->op2.size << 4;
+    st->opKind[i] = instr->op1.type | instr->op2.type << ST_OP2_SHIFT
+                    | (instr->op1.forward ? ST_OP1_FORWARD : 0)
+                    | (instr->op2.forward ? ST_OP2_FORWARD : 0);
+    st->opcode[i] = instr->opcode;
+    st->value1[i] = instr->op1.value;
+    st->offset1[i] = instr->op1.offset;
+    st->value2[i] = instr->op2.value;
+    st->offset2[i] = instr->op2.offset;
+}
+
+/*
+ * Read instruction statement `i` back into `instr`. Its name is left alone.
+ */
+void loadInstruction(const Statements * st, long i,
+                     struct Instruction * instr) {
+    int kind = st->opKind[i];
+
+    instr->type = st->type[i];
+    instr->size = st->size[i];
+    instr->opcode = st->opcode[i];
+
+    instr->op1.type = kind & 3;
+    instr->op1.size = st->opSize[i] & 0xf;
+    instr->op1.value = st->value1[i];
+    instr->op1.offset = st->offset1[i];
+    instr->op1.forward = (kind & ST_OP1_FORWARD) != 0;
+
+    instr->op2.type = (kind >> ST_OP2_SHIFT) & 3;
+    instr->op2.size = st->opSize[i] >> 4 & 0xf;
+    instr->op2.value = st->value2[i];
+    instr->op2.offset = st->offset2[i];
+    instr->op2.forward = (kind & ST_OP2_FORWARD) != 0;
+}
+
+/*
+ * Record a checked instruction and move the running address past it.
+ * Returns nonzero if out of memory.
+ */
+int addInstruction(JasContext * ctx, const struct Instruction * instr,
+                   int line) {
+    Statements * st = &ctx->stmts;
+    long i = addStatement(ctx, ST_INSTR, line);
+
+    if (i < 0) return 1;
+
+    storeInstruction(st, i, instr);
+    st->addr += instructionLength(instr);
+    return 0;
+}
+
+/*
+ * Record the definition of label `sym` at the running address.
+ * Returns nonzero if out of memory.
+ */
+int addLabel(JasContext * ctx, int sym, int line) {
+    long i = addStatement(ctx, ST_LABEL, line);
+
+    if (i < 0) return 1;
+    ctx->stmts.value1[i] = sym;
+    return 0;
+}
+
+/*
+ * Record the `len` bytes at `start` in the data pool, just put there by a
+ * data segment. Returns nonzero if out of memory.
+ */
+int addData(JasContext * ctx, long start, long len, int line) {
+    Statements * st = &ctx->stmts;
+    long i = addStatement(ctx, ST_DATA, line);
+
+    if (i < 0) return 1;
+
+    st->value1[i] = start;
+    st->value2[i] = len;
+    st->addr += len;
+    return 0;
+}
+
+/*
+ * Bytes statement `i` takes in the image.
+ */
+int statementLength(const Statements * st, long i) {
+    struct Instruction instr;
+
+    switch (st->kind[i]) {
+        case ST_INSTR:
+            loadInstruction(st, i, &instr);
+            return instructionLength(&instr);
+        case ST_DATA:
+            return st->value2[i];
+    }
+    return 0;
+}
+
+/*
+ * After a pass: drop deleted statements, then walk the program again to give
+ * every label the address it now has, and the running address its end.
+ */
+void placeStatements(JasContext * ctx) {
+    Statements * st = &ctx->stmts;
+    long i, n = 0, addr = 0;
+
+    for (i = 0; i < st->num; i++) {
+        if (st->kind[i] == ST_DELETED) continue;
+        if (n != i) {
+            st->kind[n] = st->kind[i];
+            st->type[n] = st->type[i];
+            st->size[n] = st->size[i];
+            st->opSize[n] = st->opSize[i];
+            st->opKind[n] = st->opKind[i];
+            st->opcode[n] = st->opcode[i];
+            st->value1[n] = st->value1[i];
+            st->offset1[n] = st->offset1[i];
+            st->value2[n] = st->value2[i];
+            st->offset2[n] = st->offset2[i];
+            st->line[n] = st->line[i];
+        }
+
+        if (st->kind[n] == ST_LABEL)
+            ctx->labels.tab[st->value1[n]].location = (int) addr;
+        addr += statementLength(st, n);
+        n++;
+    }
+
+    st->num = n;
+    st->addr = addr;
+}
+
+/*
+ * Encode every retained statement into ctx's emitter, in one pass. Labels
+ * were defined while parsing, so only references to labels that never were
+ * are left chained for resolveLabels(). Returns nonzero on a write error.
+ */
+int encodeStatements(JasContext * ctx) {
+    const Statements * st = &ctx->stmts;
+    struct Instruction instr = {0};
+    long i;
+
+    for (i = 0; i < st->num; i++) {
+        switch (st->kind[i]) {
+            case ST_INSTR:
+                loadInstruction(st, i, &instr);
+                if (emitInstruction(ctx, instr.opcode, instr.size,
+                                    &instr.op1, &instr.op2))
+                    goto fail;
+                break;
+
+            case ST_DATA:
+                if (emit_bytes(&ctx->emit, st->data.buf + st->value1[i],
+                               st->value2[i]))
+                    goto fail;
+                break;
+
+            case ST_LABEL:
+            case ST_DELETED:
+                break;
+        }
+    }
+
+    TRACE(TR_STATEMENTS, st->num, emit_tell(&ctx->emit), 0, 0);
+    return 0;
+
+fail:
+    /* out of memory or the output failed, nothing to do with the source */
+    fprintf(ctx->diag, "error: Could not write output.\n");
+    ctx->err = 1;
+    return 1;
+}
+
+/*
+ * Forget every statement. The arrays go away with the context's arena; the
+ * data pool is kept for the next assembly.
+ */
+void clearStatements(JasContext * ctx) {
+    Statements * st = &ctx->stmts;
+    Emitter data = st->data;
+
+    memset(st, 0, sizeof(Statements));
+    st->data = data;
+    emit_reset(&st->data);
+}
+
+void freeStatements(JasContext * ctx) {
+    emit_free(&ctx->stmts.data);
+    clearStatements(ctx);
+}
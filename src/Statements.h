@@ -0,0 +1,84 @@
+#ifndef STATEMENTS_H
+#define STATEMENTS_H
+/*
+ * Retained statements
+ * -------------------
+ *
+ * Normally each statement is encoded into the image the moment it is parsed.
+ * With a context's `retain` setting the parser records it here instead, and
+ * the image is produced afterwards by encodeStatements(), a single loop over
+ * the whole program that passes after parsing (the peephole rules, see
+ * Peephole.h) can rewrite first.
+ *
+ * Statements are stored column-wise, one array per field, so a pass touches
+ * only the fields it needs. A statement costs 27 bytes across the arrays:
+ *
+ *     kind, type, size, opSize, opKind     5 x 1
+ *     opcode                               2
+ *     value1, offset1, value2, offset2     4 x 4
+ *     line                                 4
+ *
+ * Label and data statements use the same columns: a label's value1 is its
+ * symbol, a data statement's value1/value2 are the offset and length of its
+ * bytes in `data`. Each statement's address is not stored; the parser keeps
+ * a running `addr` to define labels with, and the encoder recomputes it.
+ * A pass that changes lengths or deletes statements calls placeStatements()
+ * afterwards, to move the labels to where their statements now are.
+ */
+
+#include "Emit.h"
+
+#define STATEMENTS_MIN 1024
+
+/* what a statement is */
+enum StatementKind {
+    ST_INSTR,
+    ST_LABEL,
+    ST_DATA,
+    ST_DELETED      /* dropped by a pass, gone after placeStatements() */
+};
+
+/* opKind: operand types in the low nibble, forward flags above */
+#define ST_OP2_SHIFT   2
+#define ST_OP1_FORWARD 0x10
+#define ST_OP2_FORWARD 0x20
+
+typedef struct Statements {
+    long num, cap;
+
+    char * kind;        /* enum StatementKind                          */
+    char * type;        /* InstructionType                             */
+    char * size;        /* forced size of the instruction              */
+    char * opSize;      /* op1 size | op2 size << 4                    */
+    char * opKind;      /* op1 type | op2 type << 2 | forward flags    */
+    short * opcode;
+    int * value1, * offset1;
+    int * value2, * offset2;
+    int * line;         /* source line, for diagnostics                */
+
+    long addr;          /* image offset of the next statement          */
+    Emitter data;       /* bytes of every data statement, in order     */
+} Statements;
+
+/* bytes of arrays per statement, see above */
+#define STATEMENT_BYTES (5 * sizeof(char) + sizeof(short) + 5 * sizeof(int))
+
+struct JasContext;
+struct Instruction;
+
+/** function prototypes **/
+void storeInstruction(Statements * st, long i,
+                      const struct Instruction * instr);
+void loadInstruction(const Statements * st, long i,
+                     struct Instruction * instr);
+int addInstruction(struct JasContext * ctx, const struct Instruction * instr,
+                   int line);
+int addLabel(struct JasContext * ctx, int sym, int line);
+int addData(struct JasContext * ctx, long start, long len, int line);
+int statementLength(const Statements * st, long i);
+void placeStatements(struct JasContext * ctx);
+int encodeStatements(struct JasContext * ctx);
+void clearStatements(struct JasContext * ctx);
+void freeStatements(struct JasContext * ctx);
+
+#endif
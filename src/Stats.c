@@ -0,0 +1,62 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include <time.h>
+
+#include "Context.h"
+#include "Stats.h"
+
+/* seconds on the monotonic clock */
+double statsClock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * End a phase that began at `since`, adding its time to `phase` (if given),
+ * and return the clock for the next one to begin at. Does nothing and returns
+ * 0 unless the context is measuring.
+ */
+double statsLap(const JasContext * ctx, double * phase, double since) {
+    double now;
+
+    if (!ctx->measure) return 0;
+
+    now = statsClock();
+    if (phase != NULL) *phase += now - since;
+    return now;
+}
+
+/*
+ * Take the counts that are only known once an assembly is done from the
+ * context, for an image of `size` bytes.
+ */
+void countStats(JasContext * ctx, long size) {
+    JasStats * s = &ctx->stats;
+
+    s->labels = ctx->labels.num;
+    s->bytes = size;
+    s->reallocs += ctx->emit.growths + ctx->arena.reallocs;
+    if (ctx->arena.peak > s->arenaPeak) s->arenaPeak = ctx->arena.peak;
+}
+
+/* add up the statistics of another assembly (or part of one) */
+void addStats(JasStats * to, const JasStats * from) {
+    to->lex += from->lex;
+    to->parse += from->parse;
+    to->encode += from->encode;
+    to->resolve += from->resolve;
+    to->write += from->write;
+    to->total += from->total;
+
+    to->tokens += from->tokens;
+    to->lines += from->lines;
+    to->labels += from->labels;
+    to->fixups += from->fixups;
+    to->reallocs += from->reallocs;
+    to->bytes += from->bytes;
+    to->savedInstrs += from->savedInstrs;
+    to->savedBytes += from->savedBytes;
+    if (from->arenaPeak > to->arenaPeak) to->arenaPeak = from->arenaPeak;
+}
@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+/*
+ * Assembly statistics
+ * -------------------
+ *
+ * With a context's `measure` setting, each assembly records where its time
+ * went and how much it did, in ctx->stats. Phases are timed with a monotonic
+ * clock at their boundaries, except lexing: the parser pulls tokens one at a
+ * time, and reading the clock around every one of them would cost about as
+ * much as lexing it. Instead one token in STATS_SAMPLE is timed, less the
+ * cost of a clock read taken just before, and counted for all of them; the
+ * estimate is then taken out of the parse phase.
+ *
+ * Pipelined, lexing is timed on the lexer's thread and the parse phase keeps
+ * its waits for tokens. Split over chunks, each phase is the sum over all
+ * threads, so phases may add up to more than the wall time.
+ *
+ * Without `measure` nothing is timed, and only the token count is kept.
+ */
+
+#include <stddef.h>
+
+/* time one token in this many, a power of two */
+#define STATS_SAMPLE 64
+
+typedef struct JasStats {
+    /* seconds */
+    double lex;         /* estimated from a sample, see above              */
+    double parse;       /* parse() less lexing                             */
+    double encode;      /* encodeStatements(), when retaining              */
+    double resolve;     /* analyze(): resolveLabels(), relocating chunks   */
+    double write;       /* writeInstructions(), or writing out chunks      */
+    double total;       /* the whole jas_assemble_* call                   */
+
+    long tokens;        /* tokens the parser took                          */
+    long lines;         /* newlines lexed                                  */
+    long labels;        /* symbol table records, defined or not            */
+    long fixups;        /* placeholders left for a forward reference       */
+    long reallocs;      /* output buffer and arena arrays grown in place
+                           or moved                                        */
+    long bytes;         /* image size                                      */
+    long savedInstrs;   /* instructions the peephole rules removed         */
+    long savedBytes;    /* bytes they saved, see Peephole.h                */
+    size_t arenaPeak;   /* most arena memory held at once                  */
+} JasStats;
+
+struct JasContext;
+
+/** function prototypes **/
+double statsClock(void);
+double statsLap(const struct JasContext * ctx, double * phase, double since);
+void countStats(struct JasContext * ctx, long size);
+void addStats(JasStats * to, const JasStats * from);
+
+#endif
@@ -0,0 +1,272 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "Trace.h"
+
+/* definition of the trace flag, shared by every thread */
+bool trace_on = false;
+
+static const char * const formats[TR_NUM] = {
+#define TRACE_FORMAT(name, text, format) format,
+    TRACE_EVENTS(TRACE_FORMAT)
+#undef TRACE_FORMAT
+};
+
+static const char hasText[TR_NUM] = {
+#define TRACE_HAS_TEXT(name, text, format) text,
+    TRACE_EVENTS(TRACE_HAS_TEXT)
+#undef TRACE_HAS_TEXT
+};
+
+/* print `num` records in time order, after a note of how many were lost */
+static int printRecords(FILE * out, const TraceRecord * recs, long num,
+                        unsigned long dropped) {
+    long i;
+
+    if (dropped) fprintf(out, "[TRACE] %lu older events dropped\n", dropped);
+
+    for (i = 0; i < num; i++) {
+        const TraceRecord * r = &recs[i];
+        int len = r->len < TRACE_CHARS ? r->len : TRACE_CHARS;
+
+        fprintf(out, "[TRACE %4llu.%06llu #%u] ", r->ns / 1000000000ULL,
+                r->ns / 1000 % 1000000, r->thread);
+        if (hasText[r->event]) {
+            fprintf(out, formats[r->event], len, r->text,
+                    r->arg[0], r->arg[1], r->arg[2], r->arg[3]);
+        } else {
+            fprintf(out, formats[r->event],
+                    r->arg[0], r->arg[1], r->arg[2], r->arg[3]);
+        }
+        fputc('\n', out);
+    }
+    return ferror(out);
+}
+
+/*
+ * Decode a file made by traceWrite(), `len` bytes at `data`, to `out`.
+ * Returns nonzero if it is not a trace this build can read, or on a write
+ * error.
+ */
+int traceDecode(const char * data, size_t len, FILE * out) {
+    const unsigned * header = (const unsigned *) data;
+    const TraceRecord * recs;
+    long i, num;
+
+    if (len < TRACE_HEADER * sizeof(unsigned)
+            || header[0] != TRACE_MAGIC || header[1] != TRACE_VERSION
+            || header[2] != sizeof(TraceRecord) || header[3] != TR_NUM)
+        return 1;
+
+    num = header[4];
+    if (len < TRACE_HEADER * sizeof(unsigned) + num * sizeof(TraceRecord))
+        return 1;
+
+    recs = (const TraceRecord *) (header + TRACE_HEADER);
+    for (i = 0; i < num; i++) {
+        if (recs[i].event >= TR_NUM) return 1;
+    }
+    return printRecords(out, recs, num, header[5]);
+}
+
+#ifdef JAS_TRACE
+
+/* one thread's records */
+struct TraceRing {
+    TraceRecord rec[TRACE_RING];
+    unsigned long long written;  /* ever, the newest TRACE_RING are kept */
+    int thread;
+    struct TraceRing * next;
+};
+
+static __thread struct TraceRing * mine;
+
+static struct TraceRing * rings;
+static int numRings;
+static pthread_mutex_t ringsLock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec origin;
+
+/* order records by time, then by thread */
+static int byTime(const void * a, const void * b) {
+    const TraceRecord * x = (const TraceRecord *) a;
+    const TraceRecord * y = (const TraceRecord *) b;
+
+    if (x->ns != y->ns) return x->ns < y->ns ? -1 : 1;
+    return (int) x->thread - (int) y->thread;
+}
+
+/* a ring for the calling thread, or NULL if out of memory */
+static struct TraceRing * join(void) {
+    struct TraceRing * ring = (struct TraceRing *)
+                              calloc(1, sizeof(struct TraceRing));
+
+    if (ring == NULL) return NULL;
+
+    pthread_mutex_lock(&ringsLock);
+    ring->thread = numRings++;
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&ringsLock);
+
+    return mine = ring;
+}
+
+/*
+ * Turn tracing on. Returns nonzero if it is not built in.
+ */
+int traceStart(void) {
+    clock_gettime(CLOCK_MONOTONIC, &origin);
+    trace_on = true;
+    TRACE(TR_START, 0, 0, 0, 0);
+    return 0;
+}
+
+/*
+ * Record an event, with the first TRACE_CHARS of the `len` bytes at `text`
+ * if it carries any. Called through TRACE() and TRACE_TEXT().
+ */
+void traceEvent(int event, const char * text, int len,
+                long a, long b, long c, long d) {
+    struct TraceRing * ring = mine;
+    struct timespec ts;
+    TraceRecord * rec;
+
+    if (ring == NULL && (ring = join()) == NULL) return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    rec = &ring->rec[ring->written++ & (TRACE_RING - 1)];
+    rec->ns = (unsigned long long) (ts.tv_sec - origin.tv_sec) * 1000000000ULL
+              + ts.tv_nsec - origin.tv_nsec;
+    rec->event = (unsigned short) event;
+    rec->thread = (unsigned short) ring->thread;
+    rec->len = len;
+    rec->arg[0] = a;
+    rec->arg[1] = b;
+    rec->arg[2] = c;
+    rec->arg[3] = d;
+    if (len > 0) memcpy(rec->text, text, len < TRACE_CHARS ? len : TRACE_CHARS);
+}
+
+/*
+ * Every record kept, in time order, in `*num` records to be freed. `dropped`
+ * is set to how many were overwritten. Returns NULL (with `*num` 0 if there
+ * are none) if out of memory.
+ */
+static TraceRecord * gather(long * num, unsigned long * dropped) {
+    struct TraceRing * ring;
+    TraceRecord * recs;
+    long total = 0;
+
+    *dropped = 0;
+    for (ring = rings; ring != NULL; ring = ring->next) {
+        if (ring->written > TRACE_RING) {
+            *dropped += ring->written - TRACE_RING;
+            total += TRACE_RING;
+        } else {
+            total += ring->written;
+        }
+    }
+
+    *num = total;
+    if ((recs = (TraceRecord *) malloc((total ? total : 1)
+                                       * sizeof(TraceRecord))) == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        return NULL;
+    }
+
+    total = 0;
+    for (ring = rings; ring != NULL; ring = ring->next) {
+        long kept = ring->written > TRACE_RING ? TRACE_RING : ring->written;
+
+        memcpy(recs + total, ring->rec, kept * sizeof(TraceRecord));
+        total += kept;
+    }
+    qsort(recs, total, sizeof(TraceRecord), byTime);
+    return recs;
+}
+
+/*
+ * Decode what every thread recorded to `out`. Threads must be done tracing.
+ * Returns nonzero if out of memory or on a write error.
+ */
+int traceDump(FILE * out) {
+    unsigned long dropped;
+    long num;
+    TraceRecord * recs = gather(&num, &dropped);
+    int failed;
+
+    if (recs == NULL) return 1;
+    failed = printRecords(out, recs, num, dropped);
+    free(recs);
+    return failed;
+}
+
+/*
+ * Save what every thread recorded to `out` for traceDecode(). Threads must be
+ * done tracing. Returns nonzero if out of memory or on a write error.
+ */
+int traceWrite(FILE * out) {
+    unsigned header[TRACE_HEADER];
+    unsigned long dropped;
+    long num;
+    TraceRecord * recs = gather(&num, &dropped);
+
+    if (recs == NULL) return 1;
+
+    header[0] = TRACE_MAGIC;
+    header[1] = TRACE_VERSION;
+    header[2] = sizeof(TraceRecord);
+    header[3] = TR_NUM;
+    header[4] = num;
+    header[5] = dropped;
+
+    fwrite(header, sizeof(unsigned), TRACE_HEADER, out);
+    fwrite(recs, sizeof(TraceRecord), num, out);
+    free(recs);
+    return ferror(out);
+}
+
+/*
+ * Turn tracing off and drop every thread's records. No thread may trace
+ * afterwards.
+ */
+void traceStop(void) {
+    struct TraceRing * ring, * next;
+
+    trace_on = false;
+    for (ring = rings; ring != NULL; ring = next) {
+        next = ring->next;
+        free(ring);
+    }
+    rings = NULL;
+    numRings = 0;
+    mine = NULL;
+}
+
+#else
+
+int traceStart(void) {
+    return 1;
+}
+
+void traceEvent(int event, const char * text, int len,
+                long a, long b, long c, long d) {
+}
+
+int traceDump(FILE * out) {
+    return 0;
+}
+
+int traceWrite(FILE * out) {
+    return 1;
+}
+
+void traceStop(void) {
+}
+
+#endif
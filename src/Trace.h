@@ -0,0 +1,129 @@
+#ifndef TRACE_H
+#define TRACE_H
+/*
+ * Tracing
+ * -------
+ *
+ * TRACE() and TRACE_TEXT() record an event as one fixed-size binary record in
+ * a ring kept by the calling thread, so recording takes no lock, formats
+ * nothing and never writes. Once a ring is full the oldest records go, and a
+ * trace holds the last TRACE_RING events of each thread.
+ *
+ * Records are turned into text only when read: traceDump() decodes what every
+ * thread recorded, in time order, and traceWrite() saves it as a binary file
+ * for traceDecode() (or `jtrace') to decode later.
+ *
+ * Tracing is built in only with -DJAS_TRACE (make trace), and then costs one
+ * test of `trace_on` per event until turned on. Built without it, as `make'
+ * does, the calls compile to nothing and traceStart() fails.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TRACE_RING 16384  /* records per thread, a power of two */
+#define TRACE_ARGS 4
+#define TRACE_CHARS 16    /* bytes of text kept per record */
+
+/* the binary file traceWrite() makes */
+#define TRACE_MAGIC   0x4352544a /* "JTRC" */
+#define TRACE_VERSION 1
+#define TRACE_HEADER  6          /* unsigned values before the records */
+
+/*
+ * Every event: its name, whether it carries text, and how to print it. The
+ * format takes the text first as `%.*s' if there is any, then up to
+ * TRACE_ARGS longs.
+ */
+#define TRACE_EVENTS(X) \
+    X(TR_START,       0, "Tracing on.") \
+    X(TR_SOURCE_MAP,  0, "Mapped %ld bytes of source.") \
+    X(TR_SOURCE_READ, 0, "Read %ld bytes of source.") \
+    X(TR_PARSE_INSTR, 1, "Parsing instruction `%.*s' on line %ld") \
+    X(TR_FORCED_LEN,  1, "  Forced length for `%.*s'.") \
+    X(TR_OP_SIZE,     0, "  Chose op size %ld.") \
+    X(TR_OPERAND,     1, "  Reading operand starting with %.*s") \
+    X(TR_CHECK,       1, "  Semantic: checking `%.*s' with type %ld," \
+                         " size1 %ld size2 %ld") \
+    X(TR_ENCODE,      1, "  Final: Writing instr %.*s, op1 value %ld" \
+                         " offset %ld, op2 value %ld offset %ld") \
+    X(TR_DATA_SEG,    1, "Data segment `%.*s'") \
+    X(TR_STRING,      1, "  Reading string `%.*s'") \
+    X(TR_LABEL,       1, "Symtab: inserted `%.*s' as %ld, location %ld") \
+    X(TR_EMIT_GROW,   0, "Emit buffer grown to %ld bytes.") \
+    X(TR_STATEMENTS,  0, "Encoded %ld statements into %ld bytes.") \
+    X(TR_PEEPHOLE_RULE, 1, "  Peephole: `%.*s' on line %ld by rule %ld.") \
+    X(TR_PEEPHOLE,    0, "Peephole: %ld rewrites in %ld passes, %ld" \
+                         " instructions and %ld bytes saved.") \
+    X(TR_EMITTED,     0, "Emitted %ld bytes with %ld reallocations and %ld" \
+                         " flushes.") \
+    X(TR_ARENA,       1, "Arena `%.*s': %ld allocations, %ld bytes live," \
+                         " %ld bytes peak") \
+    X(TR_CODE_INDEX,  0, "Indexed %ld instructions in %ld blocks, %ld" \
+                         " ranges, %ld bytes.") \
+    X(TR_PIPELINE,    0, "Pipelined assembly done, failed %ld.") \
+    X(TR_CHUNKS,      0, "Assembled %ld chunks of %ld bytes on average.") \
+    X(TR_THREADS,     0, "Assembling %ld files on %ld threads.") \
+    X(TR_NO_URING,    1, "No io_uring (%.*s), using blocking I/O.") \
+    X(TR_URING,       0, "io_uring with %ld entries.") \
+    X(TR_IO_READ,     0, "Read %ld files in %ld system calls, %ld us.") \
+    X(TR_IO_WRITE,    0, "Wrote %ld files in %ld system calls, %ld us.") \
+    X(TR_DISASM,      0, "Disassembled %ld instructions, %ld data words and" \
+                         " %ld bytes.")
+
+enum TraceEvent {
+#define TRACE_ENUM(name, text, format) name,
+    TRACE_EVENTS(TRACE_ENUM)
+#undef TRACE_ENUM
+    TR_NUM
+};
+
+/* one event, 64 bytes */
+typedef struct TraceRecord {
+    unsigned long long ns;  /* since tracing was turned on              */
+    unsigned short event;   /* enum TraceEvent                          */
+    unsigned short thread;  /* threads are numbered as they first trace */
+    int len;                /* bytes of text                            */
+    long arg[TRACE_ARGS];
+    char text[TRACE_CHARS]; /* the start of the text, not terminated    */
+} TraceRecord;
+
+extern bool trace_on;
+
+#ifdef JAS_TRACE
+#define TRACE(event, a, b, c, d) \
+    do { \
+        if (trace_on) \
+            traceEvent((event), NULL, 0, (long) (a), (long) (b), (long) (c), \
+                       (long) (d)); \
+    } while (0)
+#define TRACE_TEXT(event, text, len, a, b, c, d) \
+    do { \
+        if (trace_on) \
+            traceEvent((event), (text), (len), (long) (a), (long) (b), \
+                       (long) (c), (long) (d)); \
+    } while (0)
+#else
+/* type-checked, never run */
+#define TRACE(event, a, b, c, d) \
+    do { \
+        if (0) { (void) (a); (void) (b); (void) (c); (void) (d); } \
+    } while (0)
+#define TRACE_TEXT(event, text, len, a, b, c, d) \
+    do { \
+        if (0) { (void) (text); (void) (len); (void) (a); (void) (b); \
+                 (void) (c); (void) (d); } \
+    } while (0)
+#endif
+
+/** function prototypes **/
+int traceStart(void);
+void traceEvent(int event, const char * text, int len,
+                long a, long b, long c, long d);
+int traceDump(FILE * out);
+int traceWrite(FILE * out);
+int traceDecode(const char * data, size_t len, FILE * out);
+void traceStop(void);
+
+#endif
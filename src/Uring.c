@@ -0,0 +1,160 @@
+#define _DEFAULT_SOURCE /* syscall() */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "Trace.h"
+#include "Uring.h"
+
+/*
+ * Set up a ring of `entries` submissions. Returns 0, or an errno value if the
+ * kernel has no io_uring (or will not let us have one).
+ */
+int uringInit(Uring * ring, unsigned entries) {
+    struct io_uring_params p;
+    char * sq, * cq;
+    long fd;
+
+    memset(ring, 0, sizeof(Uring));
+    memset(&p, 0, sizeof(p));
+
+    if ((fd = syscall(__NR_io_uring_setup, entries, &p)) < 0)
+        return errno;
+
+    ring->fd = fd;
+    ring->entries = p.sq_entries;
+
+    ring->sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    /* newer kernels put both rings in one mapping */
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cqMapLen > ring->sqMapLen) ring->sqMapLen = ring->cqMapLen;
+        ring->cqMapLen = 0;
+    }
+
+    ring->sqMap = mmap(NULL, ring->sqMapLen, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED) goto fail;
+
+    if (ring->cqMapLen) {
+        ring->cqMap = mmap(NULL, ring->cqMapLen, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cqMap == MAP_FAILED) goto fail;
+    } else {
+        ring->cqMap = ring->sqMap;
+    }
+
+    ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqesLen,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+            IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    sq = (char *) ring->sqMap;
+    ring->sqHead = (unsigned *) (sq + p.sq_off.head);
+    ring->sqTail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sqMask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sqArray = (unsigned *) (sq + p.sq_off.array);
+
+    cq = (char *) ring->cqMap;
+    ring->cqHead = (unsigned *) (cq + p.cq_off.head);
+    ring->cqTail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cqMask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    TRACE(TR_URING, ring->entries, 0, 0, 0);
+    return 0;
+
+fail:
+    fd = errno;
+    if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+    if (ring->cqMap == MAP_FAILED) ring->cqMap = NULL;
+    if (ring->sqMap == MAP_FAILED) ring->sqMap = NULL;
+    uringFree(ring);
+    return fd;
+}
+
+/*
+ * Next free submission entry, zeroed. When the queue is full, what is in it
+ * goes to the kernel first. Returns NULL only if that fails.
+ */
+struct io_uring_sqe * uringGet(Uring * ring) {
+    unsigned tail = *ring->sqTail + ring->sqPending;
+    struct io_uring_sqe * sqe;
+    unsigned idx;
+
+    if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE)
+            == ring->entries) {
+        if (uringSubmit(ring, 0) < 0) return NULL;
+        tail = *ring->sqTail;
+    }
+
+    idx = tail & *ring->sqMask;
+    ring->sqArray[idx] = idx;
+    ring->sqPending++;
+
+    sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+/*
+ * Hand the pending entries to the kernel and, if `wait` is nonzero, block
+ * until at least that many completions are ready. Returns 0 or -errno.
+ */
+int uringSubmit(Uring * ring, unsigned wait) {
+    unsigned submit = ring->sqPending;
+
+    __atomic_store_n(ring->sqTail, *ring->sqTail + submit, __ATOMIC_RELEASE);
+    ring->sqPending = 0;
+
+    for (;;) {
+        unsigned ready = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)
+                         - *ring->cqHead;
+        long ret;
+
+        if (submit == 0 && ready >= wait) return 0;
+
+        ret = syscall(__NR_io_uring_enter, ring->fd, submit,
+                      ready < wait ? wait : 0,
+                      ready < wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        ring->enters++;
+
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -errno;
+        }
+        submit -= ret;
+    }
+}
+
+/*
+ * Take the next completion, if any. Returns 1 if `cqe` was filled in.
+ */
+int uringReap(Uring * ring, struct io_uring_cqe * cqe) {
+    unsigned head = *ring->cqHead;
+
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+        return 0;
+
+    *cqe = ring->cqes[head & *ring->cqMask];
+    __atomic_store_n(ring->cqHead, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void uringFree(Uring * ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqesLen);
+    if (ring->cqMap && ring->cqMap != ring->sqMap)
+        munmap(ring->cqMap, ring->cqMapLen);
+    if (ring->sqMap) munmap(ring->sqMap, ring->sqMapLen);
+    if (ring->fd > 0) close(ring->fd);
+
+    memset(ring, 0, sizeof(Uring));
+}
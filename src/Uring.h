@@ -0,0 +1,37 @@
+#ifndef URING_H
+#define URING_H
+/*
+ * A bare io_uring, driven through the raw system calls so that no liburing is
+ * needed. Only what batch I/O uses: get an SQE, submit, reap CQEs.
+ */
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+typedef struct Uring {
+    int fd;
+    unsigned entries;
+
+    /* submission queue, shared with the kernel */
+    unsigned * sqHead, * sqTail, * sqMask, * sqArray;
+    struct io_uring_sqe * sqes;
+    unsigned sqPending; /* filled in but not yet submitted */
+
+    /* completion queue */
+    unsigned * cqHead, * cqTail, * cqMask;
+    struct io_uring_cqe * cqes;
+
+    void * sqMap, * cqMap;
+    size_t sqMapLen, cqMapLen, sqesLen;
+
+    long enters; /* io_uring_enter calls made */
+} Uring;
+
+/** function prototypes **/
+int uringInit(Uring * ring, unsigned entries);
+struct io_uring_sqe * uringGet(Uring * ring);
+int uringSubmit(Uring * ring, unsigned wait);
+int uringReap(Uring * ring, struct io_uring_cqe * cqe);
+void uringFree(Uring * ring);
+
+#endif
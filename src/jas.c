@@ -1,76 +1,130 @@
-
 #include <stdlib.h>
 #include <stdio.h>
 
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include <getopt.h>
 
-#include "parser.h"
+#include <sys/resource.h>
+
+#include "libjas.h"
+#include "Batch.h"
+#include "BatchIO.h"
 #include "JasStrings.h"
 
-#include "debug.h"
+#include "Trace.h"
 #include "jas.h"
 
 #define OUTSET(s) ((s).flags & OUT_FLAG)
 #define DEBUGSET(s) ((s).flags & DEBUG_FLAG)
-
-/* definition of debug flag */
-bool debug_on = false;
-char * infilename = "(stdin)"; /* default name is stdin */
+#define MEMSET(s) ((s).flags & MEM_FLAG)
+#define MAXERRSET(s) ((s).flags & MAXERR_FLAG)
+#define JOBSSET(s) ((s).flags & JOBS_FLAG)
+#define MANIFESTSET(s) ((s).flags & MANIFEST_FLAG)
+#define IOSET(s) ((s).flags & IO_FLAG)
+#define PIPELINESET(s) ((s).flags & PIPELINE_FLAG)
+#define INDEXSET(s) ((s).flags & INDEX_FLAG)
+#define TIMEREPORTSET(s) ((s).flags & TIME_REPORT_FLAG)
+#define STATSJSONSET(s) ((s).flags & STATS_JSON_FLAG)
+#define TRACESET(s) ((s).flags & TRACE_FLAG)
+#define OPTIMIZESET(s) ((s).flags & OPTIMIZE_FLAG)
 
 int main(int argc, char *argv[]) {
-    FILE * infile;  /* input and output streams */
-    FILE * outfile;
-
-    char ** infilenameptr; /* input and output filenames */
     char * outfilename = DEFAULT_OUT;
+    char * outdir = NULL; /* -o names a directory when there are many files */
+
+    Batch batch = {0};
+    int i, failed;
 
     struct argInfo info = {0}; /* zero-fill struct for argument info */
 
+    /* diagnostics go out in large writes rather than piece by piece */
+    static char errbuf[1 << 16];
+    setvbuf(stderr, errbuf, _IOFBF, sizeof(errbuf));
+
     /* interpret command line arguments */
     parseArgs(argc, (char* const*) argv, &info);
 
-    if (OUTSET(info)) outfilename = info.outfilename;
-    if (DEBUGSET(info)) {
-        debug_on = true;
+    if ((DEBUGSET(info) || TRACESET(info)) && traceStart()) {
+        fprintf(stderr, STR_NO_TRACE);
     }
 
-    DEBUG("Debugging set.");
+    batch.threads = JOBSSET(info) ? info.jobs : 1;
+    if (MEMSET(info)) batch.maxMemory = info.maxmemory;
+    if (MAXERRSET(info)) batch.maxErrors = info.maxerrors;
+    if (IOSET(info)) batch.io = info.io;
+    if (PIPELINESET(info)) batch.pipeline = 1;
+    if (INDEXSET(info)) batch.index = 1;
+    if (TIMEREPORTSET(info) || STATSJSONSET(info)) batch.stats = 1;
+    if (OPTIMIZESET(info)) batch.optimize = 1;
 
     /* parseArgs will have permuted the argv array, optind
      * points to the first element of non-options */
-    outfile = fopen(outfilename, "w");
-
-    infilenameptr = argv + optind;
-    if (optind == argc) /* empty file name */
-        infile = stdin;
-    else {
-        infilename = *infilenameptr;
-        infile = fopen(infilename, "rb"); /* TODO: this will eventually
-                                             loop to include more files!! */
-    }
+    if (!MANIFESTSET(info) && argc - optind <= 1) {
+        /* one file, or stdin, into one outfile */
+        if (OUTSET(info)) outfilename = info.outfilename;
+        if (batchAdd(&batch, optind < argc ? argv[optind] : NULL, outfilename))
+            return EXIT_FAILURE;
+    } else {
+        /* each input gets its own outfile, named after it */
+        if (OUTSET(info)) outdir = info.outfilename;
+
+        for (i = optind; i < argc; i++) {
+            char * name = batchOutName(argv[i], outdir);
+
+            if (name == NULL || batchAdd(&batch, argv[i], name)) {
+                free(name);
+                batchFree(&batch);
+                return EXIT_FAILURE;
+            }
+            free(name);
+        }
 
-    if (infile == NULL) {
-        fprintf(stderr, STR_FILE_ERR, argv[optind]);
-        return EXIT_FAILURE;
+        if ((MANIFESTSET(info)
+                    && batchManifest(&batch, info.manifest, outdir))
+                || batchCheckOutputs(&batch)) {
+            batchFree(&batch);
+            return EXIT_FAILURE;
+        }
     }
 
     /* pass in assembly */
-    assemble(infile, outfile);
+    failed = batchRun(&batch, stderr);
 
-    /* free memory */
-    free(info.outfilename);
+    /* for comparing I/O backends */
+    if (IOSET(info) && batch.ioUsed == BATCH_IO_STDIO) {
+        fprintf(stderr, STR_IO_STDIO, batch.num, batch.seconds * 1e3);
+    } else if (IOSET(info)) {
+        fprintf(stderr, STR_IO_REPORT, batchIOName(batch.ioUsed), batch.num,
+                batch.ioGroups, batch.ioSyscalls, batch.seconds * 1e3);
+    }
 
-    /* close files */
-    if (infile != stdin) fclose(infile);
+    if (OPTIMIZESET(info)) {
+        fprintf(stderr, STR_PEEPHOLE, batch.total.savedInstrs,
+                batch.total.savedBytes);
+    }
 
-    fflush(outfile);
-    fclose(outfile);
+    /* where the time went, for people and for dashboards */
+    if (batch.stats) {
+        struct rusage ru;
 
-    /* delete error file */
-    //TODO uncomment: if (yyerr) remove(outfilename);
+        getrusage(RUSAGE_SELF, &ru);
+        if (TIMEREPORTSET(info)) timeReport(stderr, &batch, ru.ru_maxrss);
+        if (STATSJSONSET(info)
+                && statsJson(info.statsjson, &batch, ru.ru_maxrss))
+            failed = 1;
+    }
+    batchFree(&batch);
 
-    return EXIT_SUCCESS;
+    /* every thread is done tracing, decode or save what they recorded */
+    if (trace_on) {
+        if (DEBUGSET(info)) traceDump(stderr);
+        if (TRACESET(info) && saveTrace(info.tracefile)) failed = 1;
+        traceStop();
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 static int parseArgs(int argc, char * const argv[], struct argInfo * info) {
@@ -85,11 +139,9 @@ static int parseArgs(int argc, char * const argv[], struct argInfo * info) {
             }
 
             case 'o': {
-                char * outfilename = (char *) malloc(strlen(optarg));
-                strcpy(outfilename, optarg);
-
+                /* argv outlives main's use of it, no copy needed */
                 info->flags |= OUT_FLAG;
-                info->outfilename = outfilename;
+                info->outfilename = optarg;
                 break;
             }
 
@@ -98,6 +150,77 @@ static int parseArgs(int argc, char * const argv[], struct argInfo * info) {
                 break;
             }
 
+            case 'O': {
+                info->flags |= OPTIMIZE_FLAG;
+                break;
+            }
+
+            case OPT_MAX_MEMORY: {
+                info->flags |= MEM_FLAG;
+                info->maxmemory = numArg("--max-memory", 0, ULONG_MAX, argv);
+                break;
+            }
+
+            case OPT_MAX_ERRORS: {
+                info->flags |= MAXERR_FLAG;
+                info->maxerrors = numArg("--max-errors", 0, INT_MAX, argv);
+                break;
+            }
+
+            case 'j': {
+                info->flags |= JOBS_FLAG;
+                info->jobs = numArg("-j", 1, INT_MAX, argv);
+                break;
+            }
+
+            case OPT_MANIFEST: {
+                info->flags |= MANIFEST_FLAG;
+                info->manifest = optarg;
+                break;
+            }
+
+            case OPT_IO: {
+                info->flags |= IO_FLAG;
+                if (strcmp(optarg, "uring") == 0
+                        || strcmp(optarg, "io_uring") == 0) {
+                    info->io = BATCH_IO_URING;
+                } else if (strcmp(optarg, "blocking") == 0) {
+                    info->io = BATCH_IO_BLOCKING;
+                } else {
+                    fprintf(stderr, STR_BAD_IO, optarg);
+                    fprintf(stderr, STR_USAGE, argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+
+            case OPT_PIPELINE: {
+                info->flags |= PIPELINE_FLAG;
+                break;
+            }
+
+            case OPT_INDEX: {
+                info->flags |= INDEX_FLAG;
+                break;
+            }
+
+            case OPT_TIME_REPORT: {
+                info->flags |= TIME_REPORT_FLAG;
+                break;
+            }
+
+            case OPT_STATS_JSON: {
+                info->flags |= STATS_JSON_FLAG;
+                info->statsjson = optarg;
+                break;
+            }
+
+            case OPT_TRACE: {
+                info->flags |= TRACE_FLAG;
+                info->tracefile = optarg;
+                break;
+            }
+
             case '?': {
                 break;
             }
@@ -114,3 +237,108 @@ static int parseArgs(int argc, char * const argv[], struct argInfo * info) {
 
     return EXIT_SUCCESS;
 }
+
+/*
+ * The number given to `option`, from `min` up to `max`. Anything else, a
+ * sign or trailing text included, is a usage error.
+ */
+static unsigned long numArg(const char * option, unsigned long min,
+                            unsigned long max, char * const argv[]) {
+    unsigned long value;
+    char * end;
+
+    errno = 0;
+    value = strtoul(optarg, &end, 0);
+    if (end == optarg || *end != '\0' || errno == ERANGE
+            || strchr(optarg, '-') || value < min || value > max) {
+        fprintf(stderr, STR_BAD_NUMBER, optarg, option);
+        fprintf(stderr, STR_USAGE, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+/* one line of the time report, as a share of all the phases */
+static void timePhase(FILE * out, const char * name, double seconds,
+                      double sum) {
+    fprintf(out, STR_TIME_PHASE, name, seconds * 1e3,
+            sum > 0 ? 100 * seconds / sum : 0.0);
+}
+
+/*
+ * Print the phases, counts and peak memory of every file the batch
+ * assembled, with `rss` the process's peak resident set in KB. Phases are
+ * summed over files and threads, so they are shown against their own sum
+ * rather than the wall time.
+ */
+static void timeReport(FILE * out, const Batch * batch, long rss) {
+    const JasStats * s = &batch->total;
+    double sum = s->lex + s->parse + s->encode + s->resolve + s->write;
+
+    fprintf(out, STR_TIME_HEAD, batch->num, batch->seconds * 1e3);
+    timePhase(out, "lex", s->lex, sum);
+    timePhase(out, "parse", s->parse, sum);
+    timePhase(out, "encode", s->encode, sum);
+    timePhase(out, "resolve", s->resolve, sum);
+    timePhase(out, "write", s->write, sum);
+    timePhase(out, "sum", sum, sum);
+    fprintf(out, STR_TIME_COUNTS, s->tokens, s->lines, s->labels, s->fixups,
+            s->reallocs, s->bytes);
+    fprintf(out, STR_TIME_MEMORY, rss / 1024.0,
+            s->arenaPeak / (1024.0 * 1024.0));
+}
+
+/*
+ * Write what timeReport() prints as one JSON object to `path`, or to stdout
+ * for `-'. Times are in milliseconds, phases summed over files and threads as
+ * there, memory in bytes. Returns nonzero if it could not be written.
+ */
+static int statsJson(const char * path, const Batch * batch, long rss) {
+    const JasStats * s = &batch->total;
+    double sum = s->lex + s->parse + s->encode + s->resolve + s->write;
+    FILE * out = stdout;
+    long errors = 0, j;
+    int failed;
+
+    for (j = 0; j < batch->num; j++) {
+        if (batch->jobs[j].err) errors++;
+    }
+
+    if (strcmp(path, "-") != 0 && (out = fopen(path, "w")) == NULL) {
+        fprintf(stderr, STR_OUT_ERR, path);
+        return 1;
+    }
+
+    fprintf(out, "{\"files\": %ld, \"failed\": %ld, \"wall_ms\": %.3f,\n",
+            batch->num, errors, batch->seconds * 1e3);
+    fprintf(out, " \"phase_sums_ms\": {\"lex\": %.3f, \"parse\": %.3f, "
+            "\"encode\": %.3f, \"resolve\": %.3f, \"write\": %.3f, "
+            "\"sum\": %.3f},\n", s->lex * 1e3, s->parse * 1e3,
+            s->encode * 1e3, s->resolve * 1e3, s->write * 1e3, sum * 1e3);
+    fprintf(out, " \"counts\": {\"tokens\": %ld, \"lines\": %ld, "
+            "\"labels\": %ld, \"fixups\": %ld, \"reallocs\": %ld, "
+            "\"bytes\": %ld, \"saved_instrs\": %ld, \"saved_bytes\": %ld},\n",
+            s->tokens, s->lines, s->labels, s->fixups, s->reallocs, s->bytes,
+            s->savedInstrs, s->savedBytes);
+    fprintf(out, " \"memory\": {\"peak_rss\": %ld, \"arena_peak\": %lu}}\n",
+            rss * 1024, (unsigned long) s->arenaPeak);
+
+    failed = ferror(out);
+    if (out != stdout && fclose(out)) failed = 1;
+    else if (out == stdout && fflush(out)) failed = 1;
+    if (failed) fprintf(stderr, STR_OUT_ERR, path);
+    return failed;
+}
+
+/*
+ * Save the trace to `path` for jtrace to decode. Returns nonzero, reported,
+ * if it could not be written.
+ */
+static int saveTrace(const char * path) {
+    FILE * out = fopen(path, "wb");
+    int failed = (out == NULL || traceWrite(out));
+
+    if (out != NULL && fclose(out)) failed = 1;
+    if (failed) fprintf(stderr, STR_OUT_ERR, path);
+    return failed;
+}
@@ -7,20 +7,58 @@
 /* masks for interpreting set flags */
 #define OUT_FLAG 0x1
 #define DEBUG_FLAG 0x2
+#define MEM_FLAG 0x4
+#define MAXERR_FLAG 0x8
+#define JOBS_FLAG 0x10
+#define MANIFEST_FLAG 0x20
+#define IO_FLAG 0x40
+#define PIPELINE_FLAG 0x80
+#define INDEX_FLAG 0x100
+#define TIME_REPORT_FLAG 0x200
+#define STATS_JSON_FLAG 0x400
+#define TRACE_FLAG 0x800
+#define OPTIMIZE_FLAG 0x1000
+
+/* long-only options, returned by getopt_long */
+#define OPT_MAX_MEMORY 256
+#define OPT_MAX_ERRORS 257
+#define OPT_MANIFEST 258
+#define OPT_IO 259
+#define OPT_PIPELINE 260
+#define OPT_INDEX 261
+#define OPT_TIME_REPORT 262
+#define OPT_STATS_JSON 263
+#define OPT_TRACE 264
 
 /* optstring for use with getopt */
-#define OPTS "ho:D"
+#define OPTS "ho:Dj:O"
 
 /* definition of long options */
 const struct option LOPTS[] = {
     {"help", no_argument, 0, 'h'},
+    {"max-memory", required_argument, 0, OPT_MAX_MEMORY},
+    {"max-errors", required_argument, 0, OPT_MAX_ERRORS},
+    {"manifest", required_argument, 0, OPT_MANIFEST},
+    {"io", required_argument, 0, OPT_IO},
+    {"pipeline", no_argument, 0, OPT_PIPELINE},
+    {"index", no_argument, 0, OPT_INDEX},
+    {"time-report", no_argument, 0, OPT_TIME_REPORT},
+    {"stats-json", required_argument, 0, OPT_STATS_JSON},
+    {"trace", required_argument, 0, OPT_TRACE},
     {0, 0, 0, 0}
 };
 
 /* holds argument information to pass back to main */
 struct argInfo {
-    char flags;
+    int flags;
     char * outfilename;
+    unsigned long maxmemory; /* bytes, for the assembler's arena */
+    int maxerrors; /* errors to print before giving up */
+    int jobs; /* files to assemble at once */
+    char * manifest; /* file listing more inputs */
+    int io; /* how batches read and write files */
+    char * statsjson; /* where the JSON stats go, `-' for stdout */
+    char * tracefile; /* where the binary trace goes */
 };
 
 /* flex globals */
@@ -30,5 +68,10 @@ extern int lineno;
 
 /* fn prototypes */
 static int parseArgs(int argc, char * const argv[], struct argInfo *);
+static unsigned long numArg(const char * option, unsigned long min,
+                            unsigned long max, char * const argv[]);
+static void timeReport(FILE * out, const Batch * batch, long rss);
+static int statsJson(const char * path, const Batch * batch, long rss);
+static int saveTrace(const char * path);
 
 #endif
@@ -0,0 +1,129 @@
+/*
+ * jdis - the Janus disassembler
+ *
+ * Reads an image assembled by jas and writes source that assembles back to
+ * the same bytes. See Disasm.h for what can and cannot be recovered.
+ *
+ * Usage: jdis [-h] [-a] [-v] [-i INDEX] [-o FILE] [image]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <getopt.h>
+
+#include "CodeIndex.h"
+#include "Disasm.h"
+#include "Source.h"
+
+#include "Trace.h"
+
+static const char * usage =
+    "usage: %s [-h] [-a] [-v] [-i INDEX] [-o FILE] [image]\n"
+    "  -a       follow each line with its offset in the image\n"
+    "  -i INDEX decode only where the code index from `jas --index'\n"
+    "           says instructions start\n"
+    "  -v       report what was decoded on stderr\n"
+    "  -o FILE  write to FILE instead of stdout\n"
+    "  -D       trace, and print the trace when done\n";
+
+/*
+ * Read the code index at `path` for `image`. Returns nonzero, reported, if it
+ * cannot be read or is not the index of an image that size.
+ */
+static int loadIndex(struct Source * index, CodeIndexView * view,
+                     const char * path, const struct Source * image) {
+    FILE * in = fopen(path, "rb");
+
+    if (in == NULL) {
+        fprintf(stderr, "error: Could not open %s.\n", path);
+        return 1;
+    }
+    if (loadSource(index, in)) {
+        fprintf(stderr, "error: Could not read %s.\n", path);
+        fclose(in);
+        return 1;
+    }
+    fclose(in);
+
+    if (readCodeIndex(view, index->data, index->len)
+            || view->size != (long) image->len) {
+        fprintf(stderr, "error: %s is not a code index of this image.\n",
+                path);
+        freeSource(index);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    const char * outname = NULL, * indexname = NULL;
+    int addresses = 0, verbose = 0, opt, failed;
+    struct Source image, index = {0};
+    CodeIndexView view;
+    DisasmStats stats;
+    FILE * in = stdin, * out = stdout;
+
+    while ((opt = getopt(argc, argv, "havi:o:D")) != -1) {
+        switch (opt) {
+            case 'h': printf(usage, argv[0]); return EXIT_SUCCESS;
+            case 'a': addresses = 1; break;
+            case 'v': verbose = 1; break;
+            case 'i': indexname = optarg; break;
+            case 'o': outname = optarg; break;
+            case 'D':
+                if (traceStart()) fprintf(stderr, "warning: Tracing is not "
+                                          "built in, see src/Trace.h.\n");
+                break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind < argc && (in = fopen(argv[optind], "rb")) == NULL) {
+        fprintf(stderr, "error: Could not open %s.\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (loadSource(&image, in)) {
+        fprintf(stderr, "error: Could not read input.\n");
+        return EXIT_FAILURE;
+    }
+    if (in != stdin) fclose(in);
+
+    if (indexname != NULL && loadIndex(&index, &view, indexname, &image)) {
+        freeSource(&image);
+        return EXIT_FAILURE;
+    }
+
+    if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "error: Could not open %s.\n", outname);
+        if (indexname != NULL) freeSource(&index);
+        freeSource(&image);
+        return EXIT_FAILURE;
+    }
+
+    if (indexname != NULL) {
+        failed = disassembleIndexed(out, image.data, image.len, &view,
+                                    addresses, &stats);
+    } else {
+        failed = disassemble(out, image.data, image.len, addresses, &stats);
+    }
+    if (out != stdout && fclose(out) != 0) failed = 1;
+    if (failed) fprintf(stderr, "error: Could not write output.\n");
+
+    if (verbose) {
+        fprintf(stderr, "%ld instructions, %ld data words, %ld data bytes\n",
+                stats.instrs, stats.dataWords, stats.dataBytes);
+    }
+
+    if (trace_on) {
+        traceDump(stderr);
+        traceStop();
+    }
+
+    if (indexname != NULL) freeSource(&index);
+    freeSource(&image);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
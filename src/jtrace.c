@@ -0,0 +1,50 @@
+/*
+ * jtrace - decode a trace saved by `jas --trace'
+ *
+ * Prints every event in time order, as `jas -D' would have. The trace must
+ * come from a jas built from the same event list (see Trace.h).
+ *
+ * Usage: jtrace [-h] [trace]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <getopt.h>
+
+#include "Source.h"
+#include "Trace.h"
+
+static const char * usage = "usage: %s [-h] [trace]\n";
+
+int main(int argc, char * argv[]) {
+    struct Source trace;
+    FILE * in = stdin;
+    int opt, failed;
+
+    while ((opt = getopt(argc, argv, "h")) != -1) {
+        switch (opt) {
+            case 'h': printf(usage, argv[0]); return EXIT_SUCCESS;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind < argc && (in = fopen(argv[optind], "rb")) == NULL) {
+        fprintf(stderr, "error: Could not open %s.\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (loadSource(&trace, in)) {
+        fprintf(stderr, "error: Could not read input.\n");
+        return EXIT_FAILURE;
+    }
+    if (in != stdin) fclose(in);
+
+    failed = traceDecode(trace.data, trace.len, stdout);
+    if (failed) fprintf(stderr, "error: Not a trace this jtrace can read.\n");
+
+    freeSource(&trace);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
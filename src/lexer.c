@@ -4,10 +4,13 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <limits.h>
+#include <string.h>
 
+#include "Context.h"
 #include "Instruction.h"
-#include "parser.h"
-#include "Registers.h"
+#include "Keywords.h"
+#include "scan.h"
+#include "Pipeline.h"
 
 #define ERROR_FMT "\033[1m%s (%d:%d) \033[1;31merror:\033[0m %s\n"
 
@@ -15,28 +18,74 @@
 #define BIN_BASE 2
 #define OCT_BASE 8
 
-extern char* infilename; // FIXME: From jas.c
-FILE* lexfile;
-int curr_line = 1, curr_col = 0, last_col; // TODO last_col necessary?for spit()
-int lo_col = 0; // The column at the beginning of a token.
-char linebuf[BUFSIZ]; // TODO maybe remove? need to figure out where to save
-                      // line info for error reporting
+static void index_line(JasContext * ctx, size_t offset);
+static Token lex_tok(JasContext * ctx);
 
-static int curr_char;
-char lexstr[BUFSIZ];
-long lexint;
-int j_err = 0;
+/*
+ * Point the lexer at a new source and reset its position.
+ */
+void lex_init(JasContext * ctx, const char * src, size_t len) {
+    Lexer * L = &ctx->lex;
+
+    L->buf = L->ptr = src;
+    L->end = src + len;
+    L->c = 0;
+    L->line = 1;
+    L->col = 0;
+    L->last_col = 0;
+    L->lo_col = 0;
+
+    // Line 1 starts the index; the old one went with the previous arena.
+    L->lineIndex = NULL;
+    L->lineIndexLen = L->lineIndexCap = 0;
+    index_line(ctx, 0);
+}
 
 /*
- * Get a line from a FILE* stream. Does not include \n, but is null terminated.
+ * Note that line `lineIndexLen * LINE_STRIDE + 1` starts at `offset`. If the
+ * index can't grow, diagnostics just scan further from its last entry.
  */
-static char* fgetline(char buf[], FILE* stream) {
-    char c;
-    int i = 0;
-    while ((c = fgetc(stream)) != '\n' && c != EOF)
-        buf[i++] = c;
-    buf[i] = '\0';
-    return buf;
+static void index_line(JasContext * ctx, size_t offset) {
+    Lexer * L = &ctx->lex;
+
+    if (L->lineIndexLen == L->lineIndexCap) {
+        long cap = L->lineIndexCap ? L->lineIndexCap * 2 : LINE_INDEX_MIN;
+        size_t * temp = (size_t *) arenaGrow(&ctx->arena, L->lineIndex,
+                L->lineIndexCap * sizeof(size_t), cap * sizeof(size_t));
+        if (temp == NULL) return;
+        L->lineIndex = temp;
+        L->lineIndexCap = cap;
+    }
+    L->lineIndex[L->lineIndexLen++] = offset;
+}
+
+/*
+ * Find the first character of the given line: jump to the nearest indexed
+ * line at or before it, then skip at most LINE_STRIDE - 1 lines forward.
+ */
+static const char * line_start(const Lexer * L, int line) {
+    long k = (line - 1) / LINE_STRIDE;
+    const char * p;
+
+    if (k >= L->lineIndexLen) k = L->lineIndexLen - 1;
+    p = L->buf + L->lineIndex[k];
+
+    for (line -= k * LINE_STRIDE + 1; line > 0 && p < L->end; line--)
+        p = scan_eol(p, L->end) + 1;
+
+    return p < L->end ? p : L->end;
+}
+
+/*
+ * Write `n` copies of `c`, a run at a time.
+ */
+static void fput_run(FILE * stream, char c, int n) {
+    char run[64];
+
+    memset(run, c, sizeof(run));
+    for (; n > (int) sizeof(run); n -= sizeof(run))
+        fwrite(run, 1, sizeof(run), stream);
+    if (n > 0) fwrite(run, 1, n, stream);
 }
 
 /*
@@ -44,164 +93,143 @@ static char* fgetline(char buf[], FILE* stream) {
  */
 static void fprint_caret(FILE* stream, int lo, int hi) {
     fputc('\t', stream);
+    fput_run(stream, ' ', lo - 1);
 
-    int col = 1;
-    while (col < lo) {
-        fputc(' ', stream);
-        col++;
-    }
-
-    fprintf(stream, "\033[1;33m");
-    fputc('^', stream);
-    while (col < hi) {
-        fputc('~', stream);
-        col++;
-    }
-    fprintf(stream, "\033[0m");
-    fputc('\n', stream);
+    fputs("\033[1;33m^", stream);
+    fput_run(stream, '~', hi - (lo < 1 ? 1 : lo));
+    fputs("\033[0m\n", stream);
 }
 
 /*
  * Error-reporting function. Provides message and relevant code snippet to user.
+ * Past `max_errors` diagnostics, further errors are only counted.
  */
-void jas_err(const char* msg, int line, int lo, int hi) {
-    char linestr[BUFSIZ];
-    long int pos;
-    fprintf(stderr, ERROR_FMT, infilename, line, hi, msg);
-
-    // Save position and seek back to the front of the line.
-    // We need to save the absolute position, since getting the whole line later
-    // moves the file ptr an unknown distance.
-    pos = ftell(lexfile);
-    fseek(lexfile, -hi, SEEK_CUR);
-
-    // Get the line in question so that we can print it out.
-    fgetline(linestr, lexfile);
-
-    int i = 0;
-    fputc('\t', stderr); // Tab line in a bit.
+void jas_err(JasContext * ctx, const char * msg, int line, int lo, int hi) {
+    FILE * out = ctx->diag;
+    const char * linestr, * eol;
+    int len, a, b;
+
+    // Error happened.
+    ctx->err = 1;
+    if (ctx->max_errors > 0 && ctx->num_errors >= ctx->max_errors) return;
+    ctx->num_errors++;
+
+    linestr = line_start(&ctx->lex, line);
+    fprintf(out, ERROR_FMT, ctx->filename, line, hi, msg);
+
+    // Find the end of the line in question so that we can print it out.
+    eol = scan_eol(linestr, ctx->lex.end);
+    len = eol - linestr;
+
+    // Clamp the highlighted columns to the line.
+    a = lo - 1 < 0 ? 0 : (lo - 1 > len ? len : lo - 1);
+    b = hi - 1 < a ? a : (hi - 1 > len ? len : hi - 1);
+
+    fputc('\t', out); // Tab line in a bit.
     // Print line up until error, then color the error.
-    while (i + 1 < lo) {
-        fputc(linestr[i++], stderr);
-    }
-    fprintf(stderr, "\033[1;33m");
-    while (i + 1 < hi) {
-        fputc(linestr[i++], stderr);
-    }
+    fwrite(linestr, 1, a, out);
+    fputs("\033[1;33m", out);
+    fwrite(linestr + a, 1, b - a, out);
     // Print rest of line without color.
-    fprintf(stderr, "\033[0m");
-    fprintf(stderr, "%s\n", linestr + i);
+    fputs("\033[0m", out);
+    fwrite(linestr + b, 1, len - b, out);
+    fputc('\n', out);
 
     // Add caret on next line over.
-    fprint_caret(stderr, lo, hi);
-
-    // Move back.
-    fseek(lexfile, pos, SEEK_SET);
+    fprint_caret(out, lo, hi);
+}
 
-    // Error happened.
-    j_err = 1;
+/*
+ * Moves to the next character of the source without touching the line and col
+ * counters. Returns EOF past the end of the source.
+ */
+static inline int advance(Lexer * L) {
+    return L->c = (L->ptr < L->end) ? (unsigned char) *L->ptr++ : EOF;
 }
 
 /*
- * Grabs the next character from the lexfile, 'eating' the current one.
- * Side effects: modifies curr_char, advances lexfile, increments the line and
+ * Grabs the next character from the source, 'eating' the current one.
+ * Side effects: modifies the current char, advances the source pointer,
+ *               increments the line and
  *               col counters.
  */
-static inline int eat(void) {
+static inline int eat(JasContext * ctx) {
+    Lexer * L = &ctx->lex;
+
     // Increment line number if we eat a newline.
-    if (curr_char == '\n') {
-        curr_line++;
-        last_col = curr_col; // FIXME: do we need last_col?
-        curr_col = 0;
+    if (L->c == '\n') {
+        L->line++;
+        // Index every LINE_STRIDE-th line, once even if spit back and re-eaten.
+        if ((L->line - 1) % LINE_STRIDE == 0
+                && (L->line - 1) / LINE_STRIDE == L->lineIndexLen)
+            index_line(ctx, L->ptr - L->buf);
+        L->last_col = L->col; // FIXME: do we need last_col?
+        L->col = 0;
     }
-    curr_col++;
-    return curr_char = fgetc(lexfile);
+    L->col++;
+    return advance(L);
 }
 
 /*
  * Peek at next character without eating current character.
  */
-static inline int peek(void) {
-    int c = fgetc(lexfile);
-    ungetc(c, lexfile);
-    return c;
+static inline int peek(Lexer * L) {
+    return (L->ptr < L->end) ? (unsigned char) *L->ptr : EOF;
 }
 
 /*
  * Spits a character back up. Helper function for reversing input.
- * Side effects: backtracks lexfile, decrements the line and col counters.
+ * Side effects: backtracks the source pointer, decrements the line and col
+ *               counters.
  */
-static inline void spit(char c) {
+static inline void spit(Lexer * L, char c) {
     // Don't spit when you haven't eaten.
-    if (curr_line == 1 && curr_col == 1) return;
+    if (L->line == 1 && L->col == 1) return;
 
     // Restore line and col numbers.
     if (c == '\n') {
-        curr_line--;
-        curr_col = last_col + 1;
+        L->line--;
+        L->col = L->last_col + 1;
     }
-    ungetc(c, lexfile);
-    curr_col--;
+    L->ptr--;
+    L->col--;
 }
 
-/** helper functions -------------------------------------------------------- */
-
 /*
- * Is this character a possible start of an identifier?
+ * Jumps ahead to `to`, which must lie on the current line, in one step.
+ * Side effects: modifies the current char, advances the source pointer and
+ *               the col counter.
  */
-static inline int is_idstart(int c) {
-    return isalpha(c) || c == '$' || c == '_';
+static inline void skip_to(Lexer * L, const char * to) {
+    L->col += to - (L->ptr - 1);
+    L->ptr = to;
+    advance(L);
 }
 
+/** helper functions -------------------------------------------------------- */
+
 /*
- * Is this character a possible continuing char of an identifer?
+ * Is this character a possible start of an identifier?
  */
-static inline int is_idcont(int c) {
-    return isalnum(c) || c == '$' || c == '_';
-}
-
-static inline int is_oct(int c) {
-    return '0' <= c && c <= '7';
+static inline int is_idstart(int c) {
+    return CC_IS(c, CC_IDSTART);
 }
 
-static inline int is_bin(int c) {
-    return c == '0' || c == '1';
+static inline int is_digit(int c) {
+    return CC_IS(c, CC_DIGIT);
 }
 
 static inline int issign(int c) {
     return c == '+' || c == '-';
 }
 
-/*
- * Is this string that of a directive?
- * FIXME: As of now, only data directives are considered.
- */
-static inline int is_dtv(const char* s) {
-    // Start with d, end with length specifier.
-    if (*s == 'd') {
-        s++;
-        switch (*s) {
-            case 'b':
-            case 'B':
-            case 'h':
-            case 'H':
-            case 'w':
-            case 'W':
-            case 's':
-            case 'S':
-                return s[1] == '\0';
-        }
-    }
-    return 0;
-}
-
 /*
  * Provides escaped version of the character, given the character
  * representation. i.e. t -> \t.
  * Works only for \t, \n, \t, \b, \f, \v and \0. Otherwise, the
  * character itself is returned.
  */
-static inline char escape(char c) {
+char lex_escape(char c) {
     switch (c) {
         case 't': return '\t';
         case 'n': return '\n';
@@ -215,332 +243,247 @@ static inline char escape(char c) {
 }
 
 /*
- * Checks if the given string is a general purpose short register.
- * Returns 1 if true, 0 if false.
+ * Value of `c` as a digit in the given base, or -1 if it isn't one.
  */
-static int is_short_reg(const char * reg) {
-    int j = 0; // Index for moving through the register token.
-
-    // Registers much start with 'r'.
-    if (reg[j++] != 'r')
-        return 0;
+static inline int digit_of(int c, int base) {
+    int d;
 
-    // Gen. purpose.
-    if (isdigit(reg[j])) {
-        // Advance to the end of the string.
-        j++;
+    if ('0' <= c && c <= '9')      d = c - '0';
+    else if ('a' <= c && c <= 'f') d = c - 'a' + 10;
+    else if ('A' <= c && c <= 'F') d = c - 'A' + 10;
+    else return -1;
 
-        // If another digit, move over once more.
-        if (isdigit(reg[j])) j++;
-
-        // If we encounter [abcd] at end of string, all is good (:
-        if ('a' <= reg[j] && reg[j] <= 'd' && reg[j+1] == '\0')
-            return 1;
-    }
-
-    // Catch-all
-    return 0;
+    return d < base ? d : -1;
 }
 
 /*
- * Checks if the given string is a general purpose long register.
- * Returns 1 if true, 0 if false.
+ * Position of the current char in the source, for marking the ends of spans.
  */
-static int is_long_reg(const char * reg) {
-    int j = 0; // Index for moving through the register token.
-
-    // Registers much start with 'r'.
-    if (reg[j++] != 'r') return 0;
-
-    // rs and rr
-    if ((reg[j] == 's' || reg[j] == 'r') && reg[j + 1] == '\0')
-        return 1;
-
-    // Gen. purpose.
-    if (isdigit(reg[j])) {
-        // Advance to the end of the string.
-        j++;
-
-        // If another digit, move over once more.
-        if (isdigit(reg[j])) j++;
-
-        // Should be at end of string now.
-        if (reg[j] == '\0') return 1;
-    }
-
-    // Catch-all
-    return 0;
-}
-
-/*
- * Check if given string is an extra register.
- * Returns 1 if true, 0 if false.
- */
-static int is_extra_reg(const char * reg) {
-    int j = 0;
-
-    // Registers much start with 'r'.
-    if (reg[j++] != 'r') return 0;
-
-    if (reg[j++] != 'e') return 0;
-
-    if (reg[j] < '0' || '6' < reg[j]) return 0;
-    j++;
-
-    if (reg[j] != '\0') return 0;
-
-    // Extra registers will fall through to here.
-    return 1;
-}
-
-static int is_kernel_reg(const char * reg) {
-    int j = 0;
-
-    // Registers much start with 'r'.
-    if (reg[j++] != 'r') return 0;
-
-    if (reg[j++] != 'k') return 0;
-
-    if (reg[j] < '0' || '7' < reg[j]) return 0;
-    j++;
-
-    if (reg[j] != '\0') return 0;
-
-    // Extra registers will fall through to here.
-    return 1;
+static inline const char * here(const Lexer * L) {
+    return (L->c == EOF) ? L->end : L->ptr - 1;
 }
 
+/** lexer ------------------------------------------------------------------- */
 
 /*
- * Read in characters for a number in a certain base. Assumes curr_char is on
- * the first character of the numeric literal.
- * Side effects: modifies curr_char.
+ * Gets the next token from the source given to lex_init().
+ * The token's `str`/`len` span points back into the source text; `value`
+ * holds anything the lexer already decoded (see Token in lexer.h).
  */
-static int fgets_base(char buf[], FILE* stream, int base) {
-    int i = 0, extra = 0;
-    if (base == 2 || base == 16) {
-        fgetc(stream);
-        curr_char = fgetc(stream); // Move past 0x / 0b.
-        extra = 2;
-    }
+Token next_tok(JasContext * ctx) {
+    Lexer * L = &ctx->lex;
+    Token tok;
 
-    int (*check)(int); // Condition each digit must fulfill.
+    ctx->stats.tokens++;
 
-    switch (base) {
-        case 2: check = is_bin; break;
-        case 8: check = is_oct; break;
-        case 10: check = isdigit; break;
-        case 16: check = isxdigit; break;
-    }
-
-    while (curr_char != EOF && check(curr_char)) {
-        buf[i++] = curr_char;
-        curr_char = fgetc(stream);
-    }
+    // Lexed ahead on another thread?
+    if (ctx->ring) return ringPop(ctx->ring);
 
-    buf[i] = '\0';
+    // Measuring, time a sample of the tokens (see Stats.h), less what
+    // reading the clock itself costs.
+    if (ctx->measure && (ctx->stats.tokens & (STATS_SAMPLE - 1)) == 0) {
+        double t0 = statsClock(), t1 = statsClock(), t2;
 
-    return extra + i;
+        tok = lex_tok(ctx);
+        t2 = statsClock();
+        ctx->stats.lex += ((t2 - t1) - (t1 - t0)) * STATS_SAMPLE;
+    } else {
+        tok = lex_tok(ctx);
+    }
+    tok.line = L->line;
+    tok.lo = L->lo_col;
+    tok.hi = L->col;
+    return tok;
 }
 
-/** lexer ------------------------------------------------------------------- */
+static Token lex_tok(JasContext * ctx) {
+    Lexer * L = &ctx->lex;
+    Token tok = {0};
 
-/*
- * Gets the next token from the `lexfile` FILE stream.
- * Side effects:
- *  - If the TokenType has an associated string, it is found in global `lexstr`.
- *  - If the TokenType has an associated integer value, look in global `lexint`.
- */
-TokenType next_tok(void) {
-    if (!curr_char) eat(); // Eat first char.
+    if (!L->c) eat(ctx); // Eat first char.
 
-    while (curr_char != EOF) {
-        lo_col = curr_col; // Save first col of the token.
+    while (L->c != EOF) {
+        L->lo_col = L->col; // Save first col of the token.
+        tok.str = here(L);
+        tok.len = 1;
 
         // Newline.
-        if (curr_char == '\n') {
-            eat();
-            return TOK_NL;
+        if (L->c == '\n') {
+            eat(ctx);
+            tok.type = TOK_NL;
+            return tok;
         }
 
-        // Skip whitespace.
-        if (isspace(curr_char)) {
-            eat();
+        // Skip whitespace, a whole run at a time.
+        if (CC_IS(L->c, CC_SPACE)) {
+            skip_to(L, scan_space(L->ptr, L->end));
             continue;
         }
 
         // Skip comments until next line.
-        if (curr_char == ';') {
-            do {
-                eat();
-            } while (curr_char != '\n' && curr_char != EOF);
+        if (L->c == ';') {
+            skip_to(L, scan_eol(L->ptr, L->end));
             continue;
         }
 
         // id ::= [A-Za-z$_][A-Za-z_$0-9]*
         // reg ::= r([0-9]|1[0-5])[abcd] | rs | re[0-6] | rk[0-7]
         // label ::= <nonopcode id>:
-        if (is_idstart(curr_char)) {
-            int i;
-            // TODO: Make this loop prettier.
-            for (i = 0; curr_char != EOF; i++) {
-                lexstr[i] = curr_char;
-                if (is_idcont(peek())) {
-                    eat();
-                } else {
-                    break;
+        if (is_idstart(L->c)) {
+            const char * s = tok.str;
+            const struct Keyword * kw;
+            int len;
+
+            // Advance to next char after the identifier.
+            skip_to(L, scan_ident(L->ptr, L->end));
+
+            len = tok.len = here(L) - s;
+
+            // Register, directive or instruction? One probe tells.
+            if ((kw = findKeyword(s, len)) != NULL) {
+                switch (kw->kind) {
+                    case KW_GL_REG:    tok.type = TOK_GL_REG; break;
+                    case KW_GS_REG:    tok.type = TOK_GS_REG; break;
+                    case KW_E_REG:     tok.type = TOK_E_REG; break;
+                    case KW_K_REG:     tok.type = TOK_K_REG; break;
+                    case KW_DIRECTIVE: tok.type = TOK_DATA_SEG; break;
+                    case KW_INSTR:     tok.type = TOK_INSTR; break;
                 }
-            }
-            lexstr[++i] = '\0';
-            eat(); // Advance to next char after the identifier.
-
-            // Register?
-            if (lexstr[0] == 'r') {
-
-                // Long or short
-                if (is_long_reg(lexstr))
-                    return TOK_GL_REG;
-                if (is_short_reg(lexstr))
-                    return TOK_GS_REG;
-
-                // Extra
-                if (is_extra_reg(lexstr))
-                    return TOK_E_REG;
-
-                // Kernel
-                if (is_kernel_reg(lexstr))
-                    return TOK_K_REG;
-            }
-
-            // Directive?
-            if (is_dtv(lexstr)) {
-                return TOK_DATA_SEG;
+                tok.value = kw->value;
+                return tok;
             }
 
-            // Instruction?
-            if (isInstruction(lexstr))
-                return TOK_INSTR;
-
             // Label?
-            if (curr_char == ':') {
-                eat(); // Eat the ':'
-                return TOK_LABEL;
+            if (L->c == ':') {
+                eat(ctx); // Eat the ':'
+                tok.type = TOK_LABEL;
+                return tok;
             }
 
             // Plain identfier
-            return TOK_ID;
+            tok.type = TOK_ID;
+            return tok;
         }
 
         // chr_lit ::= '[^\\']'
-        if (curr_char == '\'') {
-            eat(); // Get inner char.
-            if (curr_char == '\\') {
-                lexstr[0] = escape(eat());
+        if (L->c == '\'') {
+            eat(ctx); // Get inner char.
+            tok.str = here(L);
+            if (L->c == '\\') {
+                tok.value = lex_escape(eat(ctx));
             } else {
-                lexstr[0] = curr_char;
+                tok.value = L->c;
             }
-            lexstr[1] = '\0';
-            eat(); // Reach the closing quote.
+            eat(ctx); // Reach the closing quote.
+            tok.len = here(L) - tok.str;
 
             // Error: for situations like '\'
-            if (curr_char != '\'') {
-                jas_err("Character literal missing closing quote.",
-                         curr_line, lo_col, curr_col);
-                return TOK_UNK;
+            if (L->c != '\'') {
+                jas_err(ctx, "Character literal missing closing quote.",
+                         L->line, L->lo_col, L->col);
+                tok.type = TOK_UNK;
+                return tok;
             }
 
-            eat(); // Get rid of ' and advance.
-            return TOK_CHR_LIT;
+            eat(ctx); // Get rid of ' and advance.
+            tok.type = TOK_CHR_LIT;
+            return tok;
         }
 
         // str_lit ::= "(\\.|[^\\"])*"
-        if (curr_char == '"') {
-            eat(); // Get first char of string.
+        if (L->c == '"') {
+            eat(ctx); // Get first char of string.
+            tok.str = here(L);
 
             // Let by escape chars, but not single \ or ".
-            int i;
-            for (i = 0; curr_char != '"'; i++) {
+            while (L->c != '"') {
                 // Check that we don't close reach EOF before the close ".
-                if (curr_char == EOF) {
-                    jas_err("EOF while parsing string literal.",
-                            curr_line, curr_col, curr_col);
-                    return TOK_UNK;
+                if (L->c == EOF) {
+                    jas_err(ctx, "EOF while parsing string literal.",
+                            L->line, L->col, L->col);
+                    tok.type = TOK_UNK;
+                    return tok;
                 }
 
-                if (curr_char == '\\') {
-                    lexstr[i] = escape(eat());
-                } else {
-                    lexstr[i] = curr_char;
-                }
-                eat();
+                if (L->c == '\\') eat(ctx);
+                eat(ctx);
             }
-            lexstr[i] = '\0';
+            tok.len = here(L) - tok.str;
 
-            eat(); // Get rid of the " and advance.
-            return TOK_STR_LIT;
+            eat(ctx); // Get rid of the " and advance.
+            tok.type = TOK_STR_LIT;
+            return tok;
         }
 
         // num_lit ::= [+-][1-9][0-9]* | [+-]0[0-7]* | [+-]0x[0-9A-Fa-f]+
         //          |  [+-]0b[01]+
-        if ((issign(curr_char) && isdigit(peek())) || isdigit(curr_char)) {
+        if ((issign(L->c) && is_digit(peek(L))) || is_digit(L->c)) {
             int base = 10;  // Numeric base for interpreting the literal.
-            int chars_read; // Keep track of how many columns we move forward.
             int sign = +1;
+            int digit;
+            unsigned long mag = 0; // Saturates once past 32 bits.
 
             // Grab sign if it exists.
-            if (issign(curr_char)) {
-                sign = (curr_char == '+' ? +1 : -1);
-                eat(); // Get next number character.
+            if (issign(L->c)) {
+                sign = (L->c == '+' ? +1 : -1);
+                eat(ctx); // Get next number character.
             }
 
             // Choose base by prefix:
-            if (curr_char == '0') {
-                int next = peek();
+            if (L->c == '0') {
+                int next = peek(L);
                 if (next == 'x' || next == 'X') {
                     base = HEX_BASE;
+                    eat(ctx); eat(ctx); // Move past 0x.
                 } else if (next == 'b' || next == 'B') {
                     base = BIN_BASE;
+                    eat(ctx); eat(ctx); // Move past 0b.
                 } else {
                     base = OCT_BASE;
                 }
             }
 
-            // Re-place sign back into lexstr for strtol.
-            if (sign == +1) {
-                lexstr[0] = '+';
-            } else {
-                lexstr[0] = '-';
+            // Accumulate digits straight from the source.
+            while ((digit = digit_of(L->c, base)) >= 0) {
+                if (mag <= UINT_MAX) mag = mag * base + digit;
+                eat(ctx);
             }
+            tok.len = here(L) - tok.str;
 
-            // Copy in whole num literal, keep track of columns.
-            chars_read = fgets_base(lexstr + 1, lexfile, base);
-            curr_col += chars_read;
-
-            // Convert to integer value, using saved sign.
-            lexint = sign * strtol(lexstr, NULL, base);
+            tok.type = TOK_NUM;
+            tok.value = sign * (long) mag;
 
             // Check for `int` size (we can support max of 32 bits)
-            if (lexint < INT_MIN || UINT_MAX < lexint) {
-                jas_err("Integer larger than 32 bits.",
-                        curr_line, lo_col, curr_col);
+            if (mag > UINT_MAX || tok.value < INT_MIN) {
+                jas_err(ctx, "Integer larger than 32 bits.",
+                        L->line, L->lo_col, L->col);
             }
 
-            return TOK_NUM;
+            return tok;
         }
 
         // Let by various punctuation:
-        switch (curr_char) {
-            case ',': eat(); return TOK_COMMA;
-            case '.': eat(); return TOK_DOT;
-            case '+': eat(); return TOK_PLUS;
-            case '-': eat(); return TOK_MINUS;
-            case '[': eat(); return TOK_LBRACKET;
-            case ']': eat(); return TOK_RBRACKET;
+        switch (L->c) {
+            case ',': tok.type = TOK_COMMA; break;
+            case '.': tok.type = TOK_DOT; break;
+            case '+': tok.type = TOK_PLUS; break;
+            case '-': tok.type = TOK_MINUS; break;
+            case '[': tok.type = TOK_LBRACKET; break;
+            case ']': tok.type = TOK_RBRACKET; break;
+            default:  tok.type = TOK_UNK; break;
+        }
+        if (tok.type != TOK_UNK) {
+            eat(ctx);
+            return tok;
         }
 
-        jas_err("Unknown character encountered.", curr_line, lo_col, lo_col);
-        eat(); // Advance to next char.
+        jas_err(ctx, "Unknown character encountered.",
+                L->line, L->lo_col, L->lo_col);
+        eat(ctx); // Advance to next char.
     }
 
-    return TOK_EOF;
+    tok.type = TOK_EOF;
+    tok.str = L->end;
+    tok.len = 0;
+    return tok;
 }
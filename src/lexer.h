@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 
+#include <stddef.h>
+
 /** enum for the token types to expect **/
 typedef enum TokenType {
 
@@ -37,15 +39,48 @@ typedef enum TokenType {
 
 } TokenType;
 
-extern int j_err;
-extern int curr_line, curr_col, lo_col;
-extern char lexstr[];
-extern long lexint;
-extern FILE* lexfile;
+/** a single token, as handed to the parser **/
+typedef struct Token {
+    TokenType type;
+    const char * str; /* span of the token's text in the source           */
+    int len;          /* length of the span                               */
+    long value;       /* pre-decoded value, depending on the type:
+                       *   TOK_NUM, TOK_CHR_LIT  - the number/character
+                       *   TOK_*_REG             - the RegisterId
+                       *   TOK_INSTR             - index into instrLookup[]
+                       *   TOK_DATA_SEG          - directive kind, e.g. 'b'  */
+    int line;         /* where the lexer stood once past the token, which */
+    int lo, hi;       /* is where diagnostics about it point              */
+} Token;
+
+/* diagnostics find their source line through an index of every
+ * LINE_STRIDE-th line start, so they never scan more than that many lines */
+#define LINE_STRIDE     64
+#define LINE_INDEX_MIN  256
+
+struct JasContext;
+
+/** lexer state, one per JasContext **/
+typedef struct Lexer {
+    const char * buf;   /* source text being lexed                        */
+    const char * ptr;   /* one past `c`                                   */
+    const char * end;
+    int c;              /* current character, EOF past the end            */
+    int line, col;      /* position of `c`                                */
+    int last_col;       /* col before the last newline, for spit()        */
+    int lo_col;         /* the column at the beginning of a token         */
+
+    /* start offsets of every LINE_STRIDE-th line, from line 1 on */
+    size_t * lineIndex;
+    long lineIndexLen, lineIndexCap;
+} Lexer;
 
 /** lexer functions -------------------------------------------------------- **/
 
-void jas_err(const char* msg, int line, int lo, int hi);
-TokenType next_tok(void);
+void lex_init(struct JasContext * ctx, const char * src, size_t len);
+void jas_err(struct JasContext * ctx, const char * msg,
+             int line, int lo, int hi);
+Token next_tok(struct JasContext * ctx);
+char lex_escape(char c);
 
 #endif
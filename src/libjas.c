@@ -0,0 +1,384 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "Trace.h"
+#include "libjas.h"
+#include "Instruction.h"
+#include "Keywords.h"
+#include "parser.h"
+#include "Source.h"
+#include "Chunks.h"
+#include "Pipeline.h"
+#include "Peephole.h"
+
+/*
+ * Make a fresh context, reporting to stderr. Returns NULL if out of memory.
+ */
+JasContext * jas_context_new(void) {
+    JasContext * ctx = (JasContext *) calloc(1, sizeof(JasContext));
+
+    if (ctx == NULL) {
+        fprintf(stderr, "malloc() error.\n");
+        return NULL;
+    }
+
+    ctx->filename = "(buffer)";
+    ctx->diag = stderr;
+    emit_reset(&ctx->emit);
+    clearStatements(ctx);
+
+    return ctx;
+}
+
+/*
+ * Forget the last assembly but keep the settings, the output buffer and one
+ * block of the arena for the next.
+ */
+void jas_context_reset(JasContext * ctx) {
+    Token none = {0};
+    JasStats zero = {0};
+
+    ctx->err = 0;
+    ctx->num_errors = 0;
+    ctx->token = none;
+    ctx->stats = zero;
+
+    emit_reset(&ctx->emit);
+    clearLabels(ctx);
+    clearStatements(ctx);
+    clearCodeIndex(ctx);
+    arenaReset(&ctx->arena);
+}
+
+void jas_context_free(JasContext * ctx) {
+    if (ctx == NULL) return;
+
+    emit_free(&ctx->emit);
+    freeStatements(ctx);
+    arenaRelease(&ctx->arena);
+    free(ctx);
+}
+
+/* wrap up an assembly that made an image of `size` bytes */
+static void report(JasContext * ctx, long size) {
+    countStats(ctx, size);
+    TRACE(TR_EMITTED, emit_tell(&ctx->emit), ctx->emit.growths,
+          ctx->emit.flushes, 0);
+    arenaReport(&ctx->arena, ctx->filename);
+}
+
+/*
+ * Write the code index of a successfully assembled image of `size` bytes, if
+ * the context asks for one.
+ */
+static void writeIndex(JasContext * ctx, long size) {
+    if (ctx->index_out == NULL || ctx->err) return;
+
+    if (writeCodeIndex(&ctx->code, size, ctx->index_out)) {
+        fprintf(ctx->diag, "error: Could not write code index.\n");
+        ctx->err = 1;
+    }
+}
+
+/*
+ * Assemble `src` serially into ctx's emitter, streaming into `out` if given
+ * and possible. With ctx->pipeline the lexer gets a thread of its own first;
+ * should that attempt fail, it is taken back and the source done over.
+ */
+static void assembleSource(JasContext * ctx, const char * src, size_t len,
+                           FILE * out) {
+    jas_context_reset(ctx);
+
+    // Write the image out as we go when the outfile allows patching it later.
+    if (out != NULL) emit_stream(&ctx->emit, out);
+
+    if (ctx->pipeline) {
+        if (!assemblePipelined(ctx, src, len)) return;
+
+        emit_discard(&ctx->emit);
+        jas_context_reset(ctx);
+        if (out != NULL) emit_stream(&ctx->emit, out);
+    }
+
+    lex_init(ctx, src, len);
+    assemble(ctx);
+}
+
+/*
+ * Assemble `len` bytes of source at `src`. On success returns 0 and points
+ * `out` at the image, which stays valid until the context is next used.
+ * Returns nonzero if there were errors; they went to ctx->diag.
+ */
+int jas_assemble_buffer(JasContext * ctx, const char * src, size_t len,
+                        const char ** out, size_t * outlen) {
+    double start = statsLap(ctx, NULL, 0);
+    Chunks chunks;
+
+    jas_context_reset(ctx);
+
+    if (ctx->threads > 1 && !ctx->optimize
+            && !assembleChunks(&chunks, ctx, src, len, ctx->threads)) {
+        if (copyChunks(&chunks, &ctx->emit)) ctx->err = 1;
+        freeChunks(&chunks);
+    } else {
+        assembleSource(ctx, src, len, NULL);
+    }
+    writeIndex(ctx, ctx->emit.ptr);
+    statsLap(ctx, &ctx->stats.total, start);
+    report(ctx, ctx->emit.ptr);
+
+    if (ctx->err) return 1;
+
+    *out = ctx->emit.buf;
+    *outlen = ctx->emit.ptr;
+    return 0;
+}
+
+/*
+ * Assemble all of `in` into `out`. Returns nonzero if there were errors, in
+ * which case nothing is written.
+ */
+int jas_assemble_file(JasContext * ctx, FILE * in, FILE * out) {
+    double start = statsLap(ctx, NULL, 0), t;
+    struct Source src;
+    Chunks chunks;
+    long size;
+
+    jas_context_reset(ctx);
+
+    // Pull the whole infile into memory and let the lexer know about it.
+    if (loadSource(&src, in)) {
+        fprintf(ctx->diag, "error: Could not read input.\n");
+        ctx->err = 1;
+        return 1;
+    }
+
+    // Large sources may be split over threads; if that doesn't work out,
+    // assemble serially as usual. Peephole rules see the whole program, so
+    // they keep it in one piece.
+    if (ctx->threads > 1 && !ctx->optimize
+            && !assembleChunks(&chunks, ctx, src.data, src.len, ctx->threads)) {
+        t = statsLap(ctx, NULL, 0);
+        if (writeChunks(&chunks, out)) {
+            fprintf(ctx->diag, "error: Could not write output.\n");
+            ctx->err = 1;
+        }
+        statsLap(ctx, &ctx->stats.write, t);
+
+        size = chunks.base[chunks.num - 1]
+               + chunks.part[chunks.num - 1]->emit.ptr;
+        writeIndex(ctx, size);
+        freeChunks(&chunks);
+        statsLap(ctx, &ctx->stats.total, start);
+        report(ctx, size);
+        freeSource(&src);
+        return ctx->err;
+    }
+    assembleSource(ctx, src.data, src.len, out);
+
+    /* prevent writing to file if there were errors */
+    if (!ctx->err) {
+        /* write instructions to outfile */
+        t = statsLap(ctx, NULL, 0);
+        if (writeInstructions(ctx, out)) ctx->err = 1;
+        statsLap(ctx, &ctx->stats.write, t);
+        writeIndex(ctx, emit_tell(&ctx->emit));
+    } else {
+        /* take back anything streamed out already */
+        emit_discard(&ctx->emit);
+    }
+
+    statsLap(ctx, &ctx->stats.total, start);
+    report(ctx, emit_tell(&ctx->emit));
+    freeSource(&src);
+
+    return ctx->err;
+}
+
+/* ---------------------------- Structured Input ---------------------------- */
+
+/*
+ * Look up a mnemonic, in any case, for jas_emit(). Returns -1 if there is no
+ * such instruction.
+ */
+int jas_mnemonic(const char * name) {
+    const struct Keyword * kw = findKeyword(name, strlen(name));
+
+    return (kw && kw->kind == KW_INSTR) ? kw->value : -1;
+}
+
+/* the missing operand of a one- or no-operand instruction */
+struct Operand jas_none(void) {
+    struct Operand opnd = {0};
+    return opnd;
+}
+
+/* a constant, sized like a literal in the text would be */
+struct Operand jas_imm(int value) {
+    struct Operand opnd = {0};
+
+    opnd.type = OT_CONST;
+    opnd.value = value;
+    opnd.size = (CHAR_MIN <= value && value <= CHAR_MAX) ? OPSZ_SHORT
+                                                         : OPSZ_LONG;
+    return opnd;
+}
+
+/*
+ * A register by name, e.g. "r0", "r3b" or "rk1". An unknown name gives an
+ * operand of no size, which the checks in jas_emit() then reject.
+ */
+struct Operand jas_reg(const char * name) {
+    const struct Keyword * kw = findKeyword(name, strlen(name));
+    struct Operand opnd = {0};
+
+    if (kw == NULL || kw->kind < KW_GL_REG) return opnd;
+
+    opnd.type = OT_REG;
+    opnd.value = kw->value;
+    opnd.size = (kw->kind == KW_GS_REG) ? OPSZ_SHORT : OPSZ_LONG;
+    return opnd;
+}
+
+/* `[reg]' */
+struct Operand jas_ind(const char * reg) {
+    struct Operand opnd = jas_reg(reg);
+
+    if (opnd.size) opnd.type = OT_REG_ACCESS;
+    return opnd;
+}
+
+/* `[reg + offset]' */
+struct Operand jas_ind_off(const char * reg, int offset) {
+    struct Operand opnd = jas_reg(reg);
+
+    if (opnd.size) opnd.type = OT_REG_OFFSET;
+    opnd.offset = offset;
+    return opnd;
+}
+
+/*
+ * A label as a constant operand. It need not be defined yet; the reference is
+ * patched once jas_label() defines it.
+ */
+struct Operand jas_ref(JasContext * ctx, const char * label, int len) {
+    struct Operand opnd = {0};
+    int sym;
+
+    opnd.type = OT_CONST;
+    opnd.size = OPSZ_LONG;
+    opnd.value = referLabel(ctx, label, len, &sym);
+
+    if (sym != -1) {
+        opnd.value = sym;
+        opnd.forward = 1;
+    }
+    return opnd;
+}
+
+/*
+ * Start a new image to be built with jas_label() and jas_emit().
+ */
+void jas_begin(JasContext * ctx) {
+    jas_context_reset(ctx);
+
+    // Callers' label strings may be gone by the time they're reported.
+    ctx->labels.ownNames = 1;
+}
+
+/*
+ * Define a label at the current location. Returns nonzero if it was already
+ * defined.
+ */
+int jas_label(JasContext * ctx, const char * label, int len) {
+    long location = ctx->retain ? ctx->stmts.addr : emit_tell(&ctx->emit);
+
+    if (saveLabel(ctx, label, len, location)) {
+        fprintf(ctx->diag, "error: Label `%.*s' already defined.\n",
+                len, label);
+        ctx->err = 1;
+        return 1;
+    }
+
+    if (ctx->retain) {
+        long sym = internLabel(ctx, label, len);
+        if (sym >= 0) addLabel(ctx, sym, 0);
+    }
+    return 0;
+}
+
+/*
+ * Encode one instruction from its mnemonic (see jas_mnemonic()), operands and
+ * forced size (OPSZ_INDET unless it had a `.s' or `.l'). Returns nonzero if
+ * the instruction is rejected; the reason goes to ctx->diag.
+ */
+int jas_emit(JasContext * ctx, int mnemonic,
+             struct Operand op1, struct Operand op2, OperandSize size) {
+    struct Instruction instr = {0};
+    const char * msg = NULL;
+
+    if (mnemonic < 0) {
+        fprintf(ctx->diag, "error: Unknown instruction.\n");
+        ctx->err = 1;
+        return 1;
+    }
+
+    instr.name = instrLookup[mnemonic].name;
+    instr.type = instrLookup[mnemonic].type;
+    instr.opcode = instrLookup[mnemonic].opcode;
+    instr.size = size;
+    instr.op1 = op1;
+    instr.op2 = op2;
+
+    switch (checkInstruction(&instr)) {
+        case IC_BAD_SIZE:
+            msg = "Instruction operands' sizes are not in agreement.";
+            break;
+        case IC_BAD_TYPE:
+            msg = "Instruction operands do not agree with its prototype.";
+            break;
+        default:
+            if (ctx->retain ? addInstruction(ctx, &instr, 0)
+                            : saveInstruction(ctx, &instr))
+                msg = "Could not write instruction!";
+    }
+
+    if (msg != NULL) {
+        fprintf(ctx->diag, "error: %s: %s\n", instr.name, msg);
+        ctx->err = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Finish the image: report labels that were never defined and hand it out as
+ * jas_assemble_buffer() does. Returns nonzero if anything went wrong.
+ */
+int jas_end(JasContext * ctx, const char ** out, size_t * outlen) {
+    double t = statsLap(ctx, NULL, 0);
+
+    if (ctx->retain && !ctx->arena.failed) {
+        if (ctx->optimize && !ctx->err) optimizeStatements(ctx);
+        encodeStatements(ctx);
+        t = statsLap(ctx, &ctx->stats.encode, t);
+    }
+
+    if (!ctx->arena.failed) {
+        resolveLabels(ctx);
+        statsLap(ctx, &ctx->stats.resolve, t);
+    } else {
+        ctx->err = 1;
+    }
+
+    writeIndex(ctx, ctx->emit.ptr);
+    report(ctx, ctx->emit.ptr);
+
+    if (ctx->err) return 1;
+
+    *out = ctx->emit.buf;
+    *outlen = ctx->emit.ptr;
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef LIBJAS_H
+#define LIBJAS_H
+/*
+ * libjas: the assembler as a library
+ * ----------------------------------
+ *
+ * Make a context once, then assemble any number of sources with it:
+ *
+ *     JasContext * ctx = jas_context_new();
+ *     const char * image;
+ *     size_t size;
+ *
+ *     if (jas_assemble_buffer(ctx, src, len, &image, &size) == 0)
+ *         use(image, size);    (valid until the next call on ctx)
+ *
+ *     jas_context_free(ctx);
+ *
+ * The settings in a context (filename, diag, max_errors, threads, retain,
+ * optimize, index_out, measure and arena.limit) may be changed between
+ * assemblies. Contexts share no state, so threads can each run their own.
+ * With `threads` above 1, a large source is itself split over that many
+ * threads, see Chunks.h. With `retain` the whole program is parsed before
+ * any of it is encoded, see Statements.h, and `optimize` then rewrites it
+ * with peephole rules first (keeping it in one piece), see Peephole.h. With
+ * `index_out` set, each image's instruction starts are written there once it
+ * is assembled, see CodeIndex.h. With `measure`, ctx->stats tells where each
+ * assembly's time went, see Stats.h.
+ *
+ * Code generators need not print text for jas to lex again: the structured
+ * calls below build the same image straight from operands.
+ *
+ *     int add = jas_mnemonic("add"), jne = jas_mnemonic("jne");
+ *
+ *     jas_begin(ctx);
+ *     jas_label(ctx, "loop", 4);
+ *     jas_emit(ctx, add, jas_imm(1), jas_reg("r0"), OPSZ_INDET);
+ *     jas_emit(ctx, jne, jas_ref(ctx, "loop", 4), jas_none(), OPSZ_INDET);
+ *     jas_end(ctx, &image, &size);
+ *
+ * Each instruction goes through the same checks and encoder as a parsed one.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "Context.h"
+#include "Instruction.h"
+
+/** function prototypes **/
+JasContext * jas_context_new(void);
+void jas_context_reset(JasContext * ctx);
+void jas_context_free(JasContext * ctx);
+
+int jas_assemble_buffer(JasContext * ctx, const char * src, size_t len,
+                        const char ** out, size_t * outlen);
+int jas_assemble_file(JasContext * ctx, FILE * in, FILE * out);
+
+/* structured input */
+int jas_mnemonic(const char * name);
+
+struct Operand jas_none(void);
+struct Operand jas_imm(int value);
+struct Operand jas_reg(const char * name);
+struct Operand jas_ind(const char * reg);
+struct Operand jas_ind_off(const char * reg, int offset);
+struct Operand jas_ref(JasContext * ctx, const char * label, int len);
+
+void jas_begin(JasContext * ctx);
+int jas_label(JasContext * ctx, const char * label, int len);
+int jas_emit(JasContext * ctx, int mnemonic,
+             struct Operand op1, struct Operand op2, OperandSize size);
+int jas_end(JasContext * ctx, const char ** out, size_t * outlen);
+
+#endif
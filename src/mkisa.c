@@ -0,0 +1,286 @@
+/*
+ * mkisa - build-time generator for InstructionList.h and IsaTables.h
+ *
+ * Reads the ISA description in Isa.def and writes, to stdout, either the
+ * mnemonic table (`mkisa list`) or the tables instructions are checked and
+ * encoded with (`mkisa tables`). Every entry of the latter is worked out here
+ * once, from the prototypes and the operand rules below, so that at run time
+ * a check or an encoding is a few loads instead of a chain of branches.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Instruction.h"
+
+/* what a prototype accepts as an operand */
+enum { NONE, ANY, REG_IND, CONST };
+
+struct Proto {
+    const char * name;
+    int type;
+    int op[2];
+};
+
+struct Instr {
+    const char * name;
+    int opcode;
+    int type;
+};
+
+static const struct Proto protos[] = {
+#define PROTO(type, op1, op2) {#type, IT_##type, {op1, op2}},
+#define INSTR(name, opcode, type)
+#include "Isa.def"
+#undef PROTO
+#undef INSTR
+};
+
+static const struct Instr instrs[] = {
+#define PROTO(type, op1, op2)
+#define INSTR(name, opcode, type) {#name, opcode, IT_##type},
+#include "Isa.def"
+#undef PROTO
+#undef INSTR
+};
+
+#define NUM_PROTOS (int) (sizeof(protos) / sizeof(protos[0]))
+#define NUM_INSTRS (int) (sizeof(instrs) / sizeof(instrs[0]))
+
+/* size codes, the last index of isaCheck[] */
+static const int sizeOf[ISA_SIZES] = {OPSZ_INDET, OPSZ_SHORT, OPSZ_LONG};
+
+static int sizeCode(int size) {
+    return size == OPSZ_SHORT ? 1 : size == OPSZ_LONG ? 2 : 0;
+}
+
+static int accepts(int spec, int type, int size) {
+    switch (spec) {
+        case NONE:    return size == 0;
+        case ANY:     return size != 0;
+        case REG_IND: return size != 0 && type != OT_CONST;
+        case CONST:   return size != 0 && type == OT_CONST;
+    }
+    return 0;
+}
+
+static int isIndirect(int type) {
+    return type == OT_REG_ACCESS || type == OT_REG_OFFSET;
+}
+
+/*
+ * The verdict on a prototype and two operand classes, with the operands'
+ * sizes once made to agree: an operand of unknown width takes the forced
+ * size, a constant takes the other operand's.
+ */
+static int check(const struct Proto * proto, int class1, int class2,
+                 int forced) {
+    int t1 = class1 / ISA_SIZES, s1 = sizeOf[class1 % ISA_SIZES];
+    int t2 = class2 / ISA_SIZES, s2 = sizeOf[class2 % ISA_SIZES];
+    int f = sizeOf[forced];
+    int verdict = IC_OK;
+
+    if (proto->op[1] != NONE && s1 != s2) {
+        if (f != 0) {
+            if (isIndirect(t1)) s1 = f;
+            if (isIndirect(t2)) s2 = f;
+        }
+        if (t1 == OT_CONST) s1 = s2;
+        else if (t2 == OT_CONST) s2 = s1;
+    }
+
+    if (proto->op[1] != NONE && (s1 != s2 || (f != 0 && f != s1)))
+        verdict = IC_BAD_SIZE;
+    else if (!accepts(proto->op[0], t1, s1) || !accepts(proto->op[1], t2, s2))
+        verdict = IC_BAD_TYPE;
+
+    return verdict | sizeCode(s1) << ISA_SIZE1_SHIFT
+                   | sizeCode(s2) << ISA_SIZE2_SHIFT;
+}
+
+/* encoded offset of a [reg + offset] operand, R_OFF_CUSTOM if none fits */
+static int offsetCode(int isShort, int offset) {
+    int unit = isShort ? 1 : 4;
+
+    if (offset % unit != 0) return R_OFF_CUSTOM;
+
+    switch (offset / unit) {
+        case 0:  return R_OFF_0;
+        case 1:  return R_OFF_1_4;
+        case 2:  return R_OFF_2_8;
+        case 3:  return R_OFF_3_12;
+        case -1: return R_NOFF_1_4;
+        case -2: return R_NOFF_2_8;
+        case -3: return R_NOFF_3_12;
+    }
+    return R_OFF_CUSTOM;
+}
+
+static void printList(void) {
+    int i;
+
+    printf("#ifndef INSTRUCTIONLIST_H\n");
+    printf("#define INSTRUCTIONLIST_H\n");
+    printf("/* generated by mkisa from Isa.def, do not edit */\n\n");
+    printf("#include \"Instruction.h\"\n\n");
+    printf("const struct InstrRecord instrLookup[] = {\n");
+    for (i = 0; i < NUM_INSTRS; i++) {
+        printf("    {\"%s\",%*s0x%x,%*sIT_%s},\n", instrs[i].name,
+               (int) (5 - strlen(instrs[i].name)), "", instrs[i].opcode,
+               instrs[i].opcode < 0x10 ? 3 : 2, "",
+               protos[instrs[i].type].name);
+    }
+    printf("    {NULL} /* sentinel */\n");
+    printf("};\n\n");
+    printf("#endif\n");
+}
+
+static void printTables(void) {
+    int record[ISA_OPCODES], alternate[ISA_OPCODES], primary[ISA_OPCODES];
+    int it, c1, c2, f, i, j;
+
+    for (i = 0; i < ISA_OPCODES; i++)
+        record[i] = alternate[i] = primary[i] = -1;
+    for (i = 0; i < NUM_INSTRS; i++) {
+        if (record[instrs[i].opcode] == -1) record[instrs[i].opcode] = i;
+
+        /* the first record for a mnemonic is the one its name finds */
+        for (j = 0; j <= i; j++) {
+            if (0 == strcmp(instrs[i].name, instrs[j].name)) break;
+        }
+        if (primary[instrs[i].opcode] == -1)
+            primary[instrs[i].opcode] = instrs[j].opcode;
+
+        /* a later record for the same mnemonic is its other form */
+        for (j = i + 1; j < NUM_INSTRS; j++) {
+            if (0 == strcmp(instrs[i].name, instrs[j].name)) {
+                alternate[instrs[i].opcode] = instrs[j].opcode;
+                break;
+            }
+        }
+    }
+
+    printf("#ifndef ISATABLES_H\n");
+    printf("#define ISATABLES_H\n");
+    printf("/* generated by mkisa from Isa.def, do not edit */\n\n");
+    printf("#include \"Instruction.h\"\n\n");
+
+    printf("const unsigned char isaSizeCode[OPSZ_LONG + 1] = "
+           "{0, 1, 0, 0, 2};\n");
+    printf("const OperandSize isaSizeOf[ISA_SIZES] = "
+           "{OPSZ_INDET, OPSZ_SHORT, OPSZ_LONG};\n\n");
+
+    printf("const unsigned char isaArity[ISA_TYPES] = {");
+    for (it = 0; it < ISA_TYPES; it++) {
+        printf("%d%s", (protos[it].op[0] != NONE) + (protos[it].op[1] != NONE),
+               it + 1 < ISA_TYPES ? ", " : "};\n\n");
+    }
+
+    printf("/* [type][op1 class][op2 class][forced size] */\n");
+    printf("const unsigned char isaCheck[ISA_TYPES][ISA_CLASSES]"
+           "[ISA_CLASSES][ISA_SIZES] = {\n");
+    for (it = 0; it < ISA_TYPES; it++) {
+        printf("  { /* IT_%s */\n", protos[it].name);
+        for (c1 = 0; c1 < ISA_CLASSES; c1++) {
+            printf("    {");
+            for (c2 = 0; c2 < ISA_CLASSES; c2++) {
+                printf("{");
+                for (f = 0; f < ISA_SIZES; f++) {
+                    printf("%d%s", check(&protos[it], c1, c2, f),
+                           f + 1 < ISA_SIZES ? "," : "");
+                }
+                printf("}%s", c2 + 1 < ISA_CLASSES ? "," : "");
+            }
+            printf("},\n");
+        }
+        printf("  },\n");
+    }
+    printf("};\n\n");
+
+    printf("/* [op1 form][op2 form] */\n");
+    printf("const struct IsaLayout isaLayout[ISA_FORMS][ISA_FORMS] = {\n");
+    for (c1 = 0; c1 < ISA_FORMS; c1++) {
+        printf("    {");
+        for (c2 = 0; c2 < ISA_FORMS; c2++) {
+            int extra1 = c1 == OT_CONST || c1 == OF_CUSTOM;
+            int extra2 = c2 == OT_CONST || c2 == OF_CUSTOM;
+
+            printf("{%d, {%d, %d}, {%d, %d}, {%d, %d}}%s",
+                   1 + extra1 + extra2,
+                   !extra1, !extra2,
+                   extra1, extra2 ? 1 + extra1 : 0,
+                   c1 == OF_CUSTOM, c2 == OF_CUSTOM,
+                   c2 + 1 < ISA_FORMS ? ", " : "");
+        }
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    printf("/* [type][short][offset + ISA_OFFSET_MAX, or ISA_OFFSETS if "
+           "further] */\n");
+    printf("const unsigned char isaOperand[4][2][ISA_OFFSETS + 1] = {\n");
+    for (it = 0; it < 4; it++) {
+        printf("  {\n");
+        for (i = 0; i < 2; i++) {
+            printf("    {");
+            for (j = -ISA_OFFSET_MAX; j <= ISA_OFFSET_MAX + 1; j++) {
+                int code = R_OFF_0, form = it;
+
+                if (it == OT_REG_OFFSET) {
+                    code = j > ISA_OFFSET_MAX ? R_OFF_CUSTOM : offsetCode(i, j);
+                    if (code == R_OFF_CUSTOM) form = OF_CUSTOM;
+                }
+                printf("%d%s", form | code << ISA_CODE_SHIFT,
+                       j <= ISA_OFFSET_MAX ? "," : "");
+            }
+            printf("},\n");
+        }
+        printf("  },\n");
+    }
+    printf("};\n\n");
+
+    printf("/* [opcode]: record in instrLookup[], opcode of the mnemonic's "
+           "other form and of its first */\n");
+    printf("const struct IsaOpcode isaOpcodes[ISA_OPCODES] = {\n");
+    for (i = 0; i < ISA_OPCODES; i++) {
+        printf("%s{%d, %d, %d}%s", i % 6 ? " " : "    ", record[i],
+               alternate[i], primary[i], i % 6 == 5 ? ",\n" : ",");
+    }
+    printf("};\n\n");
+
+    printf("#endif\n");
+}
+
+int main(int argc, char * argv[]) {
+    int i;
+
+    /* the prototypes must be listed in enum InstructionType order */
+    for (i = 0; i < NUM_PROTOS; i++) {
+        if (protos[i].type != i) {
+            fprintf(stderr, "mkisa: PROTO(%s) out of order\n", protos[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+    if (NUM_PROTOS != ISA_TYPES) {
+        fprintf(stderr, "mkisa: expected %d prototypes\n", ISA_TYPES);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < NUM_INSTRS; i++) {
+        if (instrs[i].opcode >= ISA_OPCODES) {
+            fprintf(stderr, "mkisa: opcode of %s too large\n", instrs[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc == 2 && 0 == strcmp(argv[1], "list")) {
+        printList();
+    } else if (argc == 2 && 0 == strcmp(argv[1], "tables")) {
+        printTables();
+    } else {
+        fprintf(stderr, "usage: %s list|tables\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/*
+ * mkkeywords - build-time generator for KeywordTable.h
+ *
+ * Collects every mnemonic from instrLookup[], the data directives and all
+ * register names, then searches for per-bucket displacements that place each
+ * keyword in its own slot (hash-and-displace). Writes the table to stdout.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Instruction.h"
+#include "InstructionList.h"
+#include "Keywords.h"
+#include "Registers.h"
+
+#define MAX_KEYWORDS 512
+#define MAX_DISP     256
+
+static struct Keyword keys[MAX_KEYWORDS];
+static char names[MAX_KEYWORDS][8];
+static int nkeys = 0;
+
+static struct Keyword table[KW_SLOTS];
+static unsigned char disp[KW_BUCKETS];
+
+static void addKeyword(const char * name, int fold, int kind, int value) {
+    if (nkeys == MAX_KEYWORDS) {
+        fprintf(stderr, "mkkeywords: too many keywords\n");
+        exit(EXIT_FAILURE);
+    }
+
+    strncpy(names[nkeys], name, sizeof(names[nkeys]) - 1);
+    keys[nkeys].name = names[nkeys];
+    keys[nkeys].len = strlen(name);
+    keys[nkeys].fold = fold < 0 ? keys[nkeys].len : fold;
+    keys[nkeys].kind = kind;
+    keys[nkeys].value = value;
+    nkeys++;
+}
+
+/* register names, with ids from getRegisterId() so the two cannot disagree */
+static void addRegister(const char * name, int kind) {
+    addKeyword(name, -1, kind, getRegisterId(name, strlen(name)));
+}
+
+static void collectKeywords(void) {
+    const struct InstrRecord * record;
+    char name[8];
+    int i, j;
+
+    /* mnemonics: first record wins (CMP and TEST have an A and a B record) */
+    for (record = instrLookup; record->name != NULL; record++) {
+        for (i = 0; i < nkeys; i++) {
+            if (0 == strcmp(keys[i].name, record->name)) break;
+        }
+        if (i == nkeys)
+            addKeyword(record->name, 0, KW_INSTR, record - instrLookup);
+    }
+
+    /* data directives, `d' is lowercase but the size letter may be either */
+    addKeyword("db", 1, KW_DIRECTIVE, 'b');
+    addKeyword("dh", 1, KW_DIRECTIVE, 'h');
+    addKeyword("dw", 1, KW_DIRECTIVE, 'w');
+    addKeyword("ds", 1, KW_DIRECTIVE, 's');
+
+    /* reg ::= r([0-9]|1[0-5])[abcd]? | rs | rr | re[0-6] | rk[0-7] */
+    for (i = 0; i < 16; i++) {
+        sprintf(name, "r%d", i);
+        addRegister(name, KW_GL_REG);
+        for (j = 0; j < 4; j++) {
+            sprintf(name, "r%d%c", i, 'a' + j);
+            addRegister(name, KW_GS_REG);
+        }
+    }
+    addRegister("rs", KW_GL_REG);
+    addRegister("rr", KW_GL_REG);
+
+    for (i = 0; i <= 6; i++) {
+        sprintf(name, "re%d", i);
+        addRegister(name, KW_E_REG);
+    }
+    for (i = 0; i <= 7; i++) {
+        sprintf(name, "rk%d", i);
+        addRegister(name, KW_K_REG);
+    }
+}
+
+/* try to place every key of bucket `b` with displacement `d` */
+static int placeBucket(const int * members, int n, unsigned d) {
+    unsigned slots[MAX_KEYWORDS];
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        const struct Keyword * k = &keys[members[i]];
+        slots[i] = kwSlot(kwHash(k->name, k->len), d);
+
+        if (table[slots[i]].kind != KW_NONE) return 0;
+        for (j = 0; j < i; j++) {
+            if (slots[j] == slots[i]) return 0;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        table[slots[i]] = keys[members[i]];
+    return 1;
+}
+
+static void buildTable(void) {
+    static int members[KW_BUCKETS][MAX_KEYWORDS];
+    int counts[KW_BUCKETS] = {0};
+    int order[KW_BUCKETS];
+    int i, j, b;
+    unsigned d;
+
+    for (i = 0; i < nkeys; i++) {
+        b = kwBucket(kwHash(keys[i].name, keys[i].len));
+        members[b][counts[b]++] = i;
+    }
+
+    /* place the fullest buckets first, while the table is still empty */
+    for (i = 0; i < KW_BUCKETS; i++) order[i] = i;
+    for (i = 1; i < KW_BUCKETS; i++) {
+        for (j = i; j > 0 && counts[order[j]] > counts[order[j - 1]]; j--) {
+            int t = order[j]; order[j] = order[j - 1]; order[j - 1] = t;
+        }
+    }
+
+    for (i = 0; i < KW_BUCKETS; i++) {
+        b = order[i];
+        for (d = 0; d < MAX_DISP; d++) {
+            if (placeBucket(members[b], counts[b], d)) break;
+        }
+        if (d == MAX_DISP) {
+            fprintf(stderr, "mkkeywords: no displacement for bucket %d, "
+                            "grow KW_SLOTS\n", b);
+            exit(EXIT_FAILURE);
+        }
+        disp[b] = d;
+    }
+}
+
+static void writeTable(FILE * out) {
+    static const char * kinds[] = {
+        "KW_NONE", "KW_INSTR", "KW_DIRECTIVE",
+        "KW_GL_REG", "KW_GS_REG", "KW_E_REG", "KW_K_REG"
+    };
+    int i;
+
+    fprintf(out, "/* generated by mkkeywords, do not edit */\n\n");
+    fprintf(out, "#ifndef KEYWORDTABLE_H\n#define KEYWORDTABLE_H\n\n");
+    fprintf(out, "/* %d keywords in %d slots */\n\n", nkeys, KW_SLOTS);
+
+    fprintf(out, "static const unsigned char kwDisp[KW_BUCKETS] = {");
+    for (i = 0; i < KW_BUCKETS; i++)
+        fprintf(out, "%s%3d,", i % 12 ? " " : "\n    ", disp[i]);
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const struct Keyword kwTable[KW_SLOTS] = {\n");
+    for (i = 0; i < KW_SLOTS; i++) {
+        const struct Keyword * k = &table[i];
+        if (k->kind == KW_NONE) continue;
+
+        if (k->kind == KW_DIRECTIVE)
+            fprintf(out, "    [%3d] = {\"%s\", %d, %d, %s, '%c'},\n", i,
+                    k->name, k->len, k->fold, kinds[k->kind], k->value);
+        else
+            fprintf(out, "    [%3d] = {\"%s\", %d, %d, %s, %d},\n", i,
+                    k->name, k->len, k->fold, kinds[k->kind], k->value);
+    }
+    fprintf(out, "};\n\n#endif\n");
+}
+
+int main(void) {
+    collectKeywords();
+    buildTable();
+    writeTable(stdout);
+    return EXIT_SUCCESS;
+}
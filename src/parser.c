@@ -8,68 +8,91 @@
 #include <limits.h>
 
 #include "lexer.h"
-#include "debug.h"
+#include "Trace.h"
+#include "Emit.h"
 #include "Instruction.h"
 #include "Labels.h"
+#include "Peephole.h"
 #include "Registers.h"
+#include "Statements.h"
 
 /** local fn prototypes **/
-static void parse(void);
-static void analyze(void);
+static void parse(JasContext * ctx);
+static void analyze(JasContext * ctx);
 
 /* reading input */
-static inline void parse_line(void);
-static inline void parse_label(void);
-static inline void parse_instruction(void);
+static inline void parse_line(JasContext * ctx);
+static inline void parse_label(JasContext * ctx);
+static inline void parse_instruction(JasContext * ctx);
 
-static void parse_length_modifier(struct Instruction * instr);
-static void parse_operands(struct Instruction * instr);
-static void parse_operand(struct Operand * opnd);
-static void parse_register(struct Operand * opnd);
-static void parse_register_indirect(struct Operand * opnd);
+static void parse_length_modifier(JasContext * ctx,
+                                  struct Instruction * instr);
+static void parse_operands(JasContext * ctx, struct Instruction * instr);
+static void parse_operand(JasContext * ctx, struct Operand * opnd);
+static void parse_register(JasContext * ctx, struct Operand * opnd);
+static void parse_register_indirect(JasContext * ctx, struct Operand * opnd);
 
-static void readDataSegment(void);
+static void readDataSegment(JasContext * ctx);
+static void readData(JasContext * ctx, Emitter * out);
 
 /* utility functions */
 static OperandSize opSizeOfNum(int);
-static int isRegType(OperandType);
-
-// Current token.
-static TokenType token;
 
 /* ------------------------ Main Entry Functions  --------------------------- */
 
-/** entry function to begin assembling **/
-void assemble(FILE * in, FILE * out) {
-    // Let the lexer know about the infile.
-    lexfile = in;
-
-    // /* grab the first line */
-    // fgets(linebuf, MAX_LINE_LENGTH, in);
-    // linebuf[strlen(linebuf) - 1] = '\0';
-    // rewind(in);
-
-    parse(); /* initial parsing, label recognition,
-                type saving and syntax checks */
-
-    analyze(); /* label resolution and type analysis */
+/*
+ * Assemble the source the context's lexer was pointed at. The image is left
+ * in (or streamed out of) the context's emitter; ctx->err tells whether it is
+ * any good.
+ */
+void assemble(JasContext * ctx) {
+    double lexed = ctx->stats.lex, t = statsLap(ctx, NULL, 0);
+
+    parse(ctx); /* initial parsing, label recognition,
+                   type saving and syntax checks */
+    t = statsLap(ctx, &ctx->stats.parse, t);
+    ctx->stats.parse -= ctx->stats.lex - lexed;
+    if (ctx->stats.parse < 0) ctx->stats.parse = 0;
+    ctx->stats.lines += ctx->token.line - 1;
+
+    /* retained statements are encoded in one go, errors or not, so that the
+       same references are left for analyze() to report; rewriting a program
+       with errors in it is pointless */
+    if (ctx->retain && !ctx->arena.failed) {
+        if (ctx->optimize && !ctx->err) optimizeStatements(ctx);
+        encodeStatements(ctx);
+        t = statsLap(ctx, &ctx->stats.encode, t);
+    }
 
-    /* prevent writing to file if there were errors */
-    if (!j_err) {
-        /* write instructions to outfile */
-        writeInstructions(out);
+    /* label resolution and type analysis, pointless if we ran out of memory */
+    if (!ctx->arena.failed) {
+        analyze(ctx);
+        statsLap(ctx, &ctx->stats.resolve, t);
     }
 }
 
-static void parse(void) {
-    // Parse lines until EOF.
-    while ((token = next_tok()) != TOK_EOF) {
-        parse_line();
+static void parse(JasContext * ctx) {
+    // Parse lines until EOF, until we run out of memory, or until enough
+    // errors have been reported.
+    while ((ctx->token = next_tok(ctx)).type != TOK_EOF) {
+        parse_line(ctx);
+
+        if (ctx->arena.failed) {
+            ctx->err = 1;
+            break;
+        }
+
+        // Nothing more would be shown, so don't bother with the rest.
+        if (ctx->max_errors > 0 && ctx->num_errors >= ctx->max_errors) {
+            fprintf(ctx->diag, "Stopping after %d errors.\n",
+                    ctx->num_errors);
+            break;
+        }
     }
 }
 
-static void analyze(void) {
-    resolveLabels();
+static void analyze(JasContext * ctx) {
+    resolveLabels(ctx);
 }
 
 /* ------------------------- Parse Functions -------------------------------- */
@@ -81,25 +104,24 @@ static void analyze(void) {
  * the token after the label).
  */
 
-static inline void parse_line(void) {
+static inline void parse_line(JasContext * ctx) {
     // Let by empty lines.
-    if (token == TOK_NL) return;
+    if (ctx->token.type == TOK_NL) return;
 
-    if (token == TOK_LABEL) {
+    if (ctx->token.type == TOK_LABEL) {
 
-        parse_label();
+        parse_label(ctx);
 
-    } else if (token == TOK_INSTR) {
+    } else if (ctx->token.type == TOK_INSTR) {
 
-        parse_instruction();
+        parse_instruction(ctx);
 
-    } else if (token == TOK_DATA_SEG) {
+    } else if (ctx->token.type == TOK_DATA_SEG) {
 
-        readDataSegment();
+        readDataSegment(ctx);
 
     } else {
-        jas_err("Line must start with label, instruction, or data segment.",
-                curr_line, lo_col, curr_col);
+        ERR_HERE("Line must start with label, instruction, or data segment.");
     }
 }
 
@@ -109,8 +131,16 @@ static inline void parse_line(void) {
  * Pre-conditions: current token is TOK_LABEL.
  * Post-conditions: current token is the one following the label and its colon.
  */
-static inline void parse_label(void) {
-    saveLabel(lexstr, instrPtr);
+static inline void parse_label(JasContext * ctx) {
+    long location = ctx->retain ? ctx->stmts.addr : emit_tell(&ctx->emit);
+
+    if (saveLabel(ctx, ctx->token.str, ctx->token.len, location))
+        ERR_QUIT("Label already defined.");
+
+    if (ctx->retain) {
+        long sym = internLabel(ctx, ctx->token.str, ctx->token.len);
+        if (sym >= 0) addLabel(ctx, sym, ctx->token.line);
+    }
 }
 
 /*
@@ -119,62 +149,46 @@ static inline void parse_label(void) {
  * Post-conditions: current token is the one following the last operand of the
  *                  instruction.
  */
-static inline void parse_instruction(void) {
-    DEBUG("Parsing instruction `%s'", lexstr);
+static inline void parse_instruction(JasContext * ctx) {
+    TRACE_TEXT(TR_PARSE_INSTR, ctx->token.str, ctx->token.len,
+               ctx->token.line, 0, 0, 0);
     struct Instruction newInstr = {0};
-    struct InstrRecord info;
+    int line = ctx->token.line;
 
-    // Get instruction opcode.
-    getInstrInfo(lexstr, &info);
-    newInstr.name = info.name;
-    newInstr.type = info.type;
-    newInstr.opcode = info.opcode;
+    // Get instruction opcode, already looked up by the lexer.
+    const struct InstrRecord * info = &instrLookup[ctx->token.value];
+    newInstr.name = info->name;
+    newInstr.type = info->type;
+    newInstr.opcode = info->opcode;
 
     // Parse next token.
-    token = next_tok();
+    ctx->token = next_tok(ctx);
 
     // Length modifier?
-    if (token == TOK_DOT) {
+    if (ctx->token.type == TOK_DOT) {
         // TODO write out this function and set below code into it
-        parse_length_modifier(&newInstr);
+        parse_length_modifier(ctx, &newInstr);
     }
 
     // Read the operands.
-    parse_operands(&newInstr);
-
-    /* opcodes for CMP and TEST */
-    #define OP_CMP  0x05
-    #define OP_TEST 0x07
-
-    // Special case for CMP and TEST, which have reverse operand types: A/B.
-    if (newInstr.opcode == OP_CMP || newInstr.opcode == OP_TEST) {
-        // Assign the appropriate prototype based on the operand types.
-        if (isRegType(newInstr.op2.type)) {
-            newInstr.type = IT_A;
-        } else if (isRegType(newInstr.op1.type)) {
-            newInstr.type = IT_B;
-            newInstr.opcode++; // Set opcode to the next record (the B type).
-        }
-    }
+    parse_operands(ctx, &newInstr);
 
     // FIXME: should these checks should be in the analyze() function?
-    // Semantic checks
-    DEBUG("  Semantic: checking `%s' with type %d\n\t  size1 %d size2 %d",
-            newInstr.name,     newInstr.type,
-            newInstr.op1.size, newInstr.op2.size);
-
-    if (!instructionSizeAgreement(&newInstr)) {
-        fprintf(stderr, "Instruction %s:\n", newInstr.name);
-        ERR_QUIT("Instruction operands' sizes are not in agreement.");
-    }
-
-    if (!instructionTypeAgreement(&newInstr)) {
-        ERR_QUIT("Instruction operands do not agree with its prototype.");
+    // Semantic checks, shared with the structured API.
+    switch (checkInstruction(&newInstr)) {
+        case IC_BAD_SIZE:
+            fprintf(ctx->diag, "Instruction %s:\n", newInstr.name);
+            ERR_QUIT("Instruction operands' sizes are not in agreement.");
+
+        case IC_BAD_TYPE:
+            ERR_QUIT("Instruction operands do not agree with its prototype.");
     }
 
     // XXX: is this a good place to write out the instruction?
-    /* write the machine code for this instruction into the buffer */
-    if (saveInstruction(&newInstr)) {
+    /* write the machine code for this instruction into the buffer, or keep
+       the instruction for encodeStatements() */
+    if (ctx->retain ? addInstruction(ctx, &newInstr, line)
+                    : saveInstruction(ctx, &newInstr)) {
         ERR_QUIT("Could not write instruction!");
     }
 }
@@ -186,22 +200,28 @@ static inline void parse_instruction(void) {
  * Post-conditions: current token is the one following the length modifier.
  *                  `instr` will contain size information of the instruction.
  */
-static void parse_length_modifier(struct Instruction * instr) {
-    DEBUG("  Forced length for `%s'.", instr->name);
+static void parse_length_modifier(JasContext * ctx,
+                                  struct Instruction * instr) {
+    TRACE_TEXT(TR_FORCED_LEN, instr->name, strlen(instr->name), 0, 0, 0, 0);
 
-    token = next_tok(); // Advance to length modifier.
+    ctx->token = next_tok(ctx); // Advance to length modifier.
 
-    if (*lexstr == 's') {
+    // Only a one-letter identifier can be one; at the end of the source the
+    // token's text is past the end of it.
+    if (ctx->token.type != TOK_ID || ctx->token.len != 1)
+        ERR_QUIT("Expected length modifier.");
+
+    if (*ctx->token.str == 's') {
         instr->size = OPSZ_SHORT;
-    } else if (*lexstr == 'l') {
+    } else if (*ctx->token.str == 'l') {
         instr->size = OPSZ_LONG;
     } else {
         ERR_QUIT("Invalid length modifier, expecting 's' or 'l'");
     }
 
-    DEBUG("  Chose op size %d.", instr->size);
+    TRACE(TR_OP_SIZE, instr->size, 0, 0, 0);
 
-    token = next_tok(); // Advance to operands.
+    ctx->token = next_tok(ctx); // Advance to operands.
 }
 
 /*
@@ -210,23 +230,24 @@ static void parse_length_modifier(struct Instruction * instr) {
  * Post-conditions: current token is one following the last operand.
  *                  `instr` will contain information about the operands.
  */
-static inline void parse_operands(struct Instruction * instr) {
+static inline void parse_operands(JasContext * ctx,
+                                  struct Instruction * instr) {
     // Because there are no-operand, one-operand, and two-operand instructions,
     // there is a possibility of TOK_NL appearing throughout parsing these.
 
-    if (token == TOK_NL) return; // No-operand instruction.
+    if (ctx->token.type == TOK_NL) return; // No-operand instruction.
 
     // First operand.
-    parse_operand(&instr->op1);
+    parse_operand(ctx, &instr->op1);
 
-    if (token == TOK_NL) return; // One-operand instruction.
+    if (ctx->token.type == TOK_NL) return; // One-operand instruction.
 
     // Expect a comma before a second operand.
-    if (token != TOK_COMMA) ERR_QUIT("Expected comma.");
+    if (ctx->token.type != TOK_COMMA) ERR_QUIT("Expected comma.");
 
     // Advance to next operand.
-    token = next_tok();
-    parse_operand(&instr->op2); // Two-operand instruction.
+    ctx->token = next_tok(ctx);
+    parse_operand(ctx, &instr->op2); // Two-operand instruction.
 }
 
 /*
@@ -235,43 +256,48 @@ static inline void parse_operands(struct Instruction * instr) {
  * Post-conditions: current token is one following the operand.
  *                  `opnd` will contain information about the operand.
  */
-static void parse_operand(struct Operand * opnd) {
-    DEBUG("  Reading operand starting with %s", lexstr);
+static void parse_operand(JasContext * ctx, struct Operand * opnd) {
+    TRACE_TEXT(TR_OPERAND, ctx->token.str, ctx->token.len, 0, 0, 0, 0);
 
     // Four possibilities: Constant, Register, Register Indirect, or Identifier.
-    if (token == TOK_NUM) {
+    if (ctx->token.type == TOK_NUM) {
 
         // Populate struct with relevant info.
         opnd->type = OT_CONST;
-        opnd->value = lexint;
-        opnd->size = opSizeOfNum(lexint);
+        opnd->value = ctx->token.value;
+        opnd->size = opSizeOfNum(ctx->token.value);
         // .offset member is irrelevant.
 
         // Advance token past the number.
-        token = next_tok();
+        ctx->token = next_tok(ctx);
 
-    } else if (isRegister(token)) {
+    } else if (isRegister(ctx->token.type)) {
 
-        parse_register(opnd);
+        parse_register(ctx, opnd);
 
-    } else if (token == TOK_LBRACKET) {
+    } else if (ctx->token.type == TOK_LBRACKET) {
 
-        parse_register_indirect(opnd);
+        parse_register_indirect(ctx, opnd);
 
-    } else if (token == TOK_ID) {
+    } else if (ctx->token.type == TOK_ID) {
         // Assume it's a label, try to do label resolution.
-        // If we can't, it's fine, we'll get it on the second pass!
+        // If we can't, it's fine, the label patches it once defined!
+        // Its value isn't known yet, so it's sized long; a constant takes a
+        // word of its own at either size, so that costs nothing.
+        int sym;
         opnd->type = OT_CONST;
         opnd->size = OPSZ_LONG;
-        opnd->value = getLabelLocation(lexstr);
+        opnd->value = referLabel(ctx, ctx->token.str, ctx->token.len,
+                                 &sym);
 
-        // Save undefined labels, increment LC to next available space.
-        if (opnd->value == -1) {
-            saveUndefLabel(lexstr, instrPtr + sizeof(int));
+        // Undefined labels: remember the symbol, saveInstruction() chains it.
+        if (sym != -1) {
+            opnd->value = sym;
+            opnd->forward = 1;
         }
 
         // Advance token past the identifier.
-        token = next_tok();
+        ctx->token = next_tok(ctx);
 
     } else {
         ERR_QUIT("Unrecognizable operand.");
@@ -286,19 +312,19 @@ static void parse_operand(struct Operand * opnd) {
  * Post-conditions: current token is the one following the register token.
  *
  */
-static void parse_register(struct Operand * opnd) {
+static void parse_register(JasContext * ctx, struct Operand * opnd) {
     /* check register size */
-    if (token == TOK_GS_REG) {
+    if (ctx->token.type == TOK_GS_REG) {
         opnd->size = OPSZ_SHORT;
     } else { /* the rest can have size long */
         opnd->size = OPSZ_LONG;
     }
 
     opnd->type = OT_REG;
-    opnd->value = getRegisterId(lexstr);
+    opnd->value = ctx->token.value; // RegisterId, decoded by the lexer.
 
     // Advance to token after register.
-    token = next_tok();
+    ctx->token = next_tok(ctx);
 }
 
 /*
@@ -308,113 +334,126 @@ static void parse_register(struct Operand * opnd) {
  * Post-conditions: current token is after the TOK_RBRACKET of the indirect.
  *                  `opnd` will contain information about the operand.
  */
-static void parse_register_indirect(struct Operand * opnd) {
-    token = next_tok(); // Grab inner token of the indirection.
+static void parse_register_indirect(JasContext * ctx, struct Operand * opnd) {
+    ctx->token = next_tok(ctx); // Grab inner token of the indirection.
 
     // Two possibilities, Register or Register with Constant following.
-    if (!isRegister(token) && token != TOK_NUM)
+    if (!isRegister(ctx->token.type) && ctx->token.type != TOK_NUM)
         ERR_QUIT("Expected register or number following '['.");
 
-    if (isRegister(token)) {
+    if (isRegister(ctx->token.type)) {
         // Get that register.
-        parse_register(opnd);
+        parse_register(ctx, opnd);
 
-        if (token == TOK_RBRACKET) {
+        if (ctx->token.type == TOK_RBRACKET) {
 
             opnd->type = OT_REG_ACCESS; // Set type to simple indirect access.
 
-        } else if (token == TOK_PLUS
-                || token == TOK_MINUS
-                || token == TOK_NUM) {
+        } else if (ctx->token.type == TOK_PLUS
+                || ctx->token.type == TOK_MINUS
+                || ctx->token.type == TOK_NUM) {
             // Save the sign of the offset.
-            int sign = (token == TOK_PLUS ? +1 : -1);
+            int sign = (ctx->token.type == TOK_PLUS ? +1 : -1);
             int offset; // Hold offset 
 
             // If we accidentally parse a TOK_NUM here but
             // it has [+-] as its start character, use it as the offset.
-            if (token == TOK_NUM && (*lexstr == '-' || *lexstr == '+')) {
-                offset = lexint;
+            if (ctx->token.type == TOK_NUM
+                    && (*ctx->token.str == '-' || *ctx->token.str == '+')) {
+                offset = ctx->token.value;
             } else {
                 // Next token should be a number.
-                token = next_tok();
-                if (token != TOK_NUM) ERR_QUIT("Expected constant offset.");
-                offset = sign * lexint;
+                ctx->token = next_tok(ctx);
+                if (ctx->token.type != TOK_NUM)
+                    ERR_QUIT("Expected constant offset.");
+                offset = sign * ctx->token.value;
             }
 
             opnd->offset = offset;
             opnd->type = OT_REG_OFFSET;
 
             // Advance token to ']'.
-            token = next_tok();
+            ctx->token = next_tok(ctx);
         } else {
             ERR_QUIT("Expected '+', '-', or ']'.");
         }
 
-    } else if (token == TOK_NUM) {
+    } else if (ctx->token.type == TOK_NUM) {
 
         // Set data as offset indirect access.
         opnd->type = OT_REG_OFFSET;
-        opnd->offset = lexint;
+        opnd->offset = ctx->token.value;
 
-        token = next_tok();
+        ctx->token = next_tok(ctx);
         // Next token should be a plus sign.
-        if (token != TOK_PLUS)
+        if (ctx->token.type != TOK_PLUS)
             ERR_QUIT("Expected '+'.");
 
         // Next token should be a register.
-        parse_register(opnd);
+        ctx->token = next_tok(ctx);
+        if (!isRegister(ctx->token.type))
+            ERR_QUIT("Expected register.");
+        parse_register(ctx, opnd);
+        opnd->type = OT_REG_OFFSET; // parse_register() made it a register.
     }
 
     // Next token must be a closing bracket.
-    if (token != TOK_RBRACKET) ERR_QUIT("Expected ']'.");
+    if (ctx->token.type != TOK_RBRACKET) ERR_QUIT("Expected ']'.");
 
     // Advance to token after ']'.
-    token = next_tok();
+    ctx->token = next_tok(ctx);
 }
 
-static void readDataSegment(void) {
-    TokenType token;
-    char * temp; /* reallocation temp */
+/*
+ * Read a data segment into the image, or while retaining into the data pool
+ * followed by a statement for it.
+ */
+static void readDataSegment(JasContext * ctx) {
+    Emitter * pool = &ctx->stmts.data;
+    int line = ctx->token.line;
+    long start = pool->ptr;
+
+    if (!ctx->retain) {
+        readData(ctx, &ctx->emit);
+        return;
+    }
 
-    DEBUG("Data segment `%s'", lexstr);
+    readData(ctx, pool);
+    if (pool->ptr > start) addData(ctx, start, pool->ptr - start, line);
+}
+
+static void readData(JasContext * ctx, Emitter * out) {
+    TRACE_TEXT(TR_DATA_SEG, ctx->token.str, ctx->token.len, 0, 0, 0, 0);
 
     /* what kind of segment is it? */
-    switch (lexstr[strlen(lexstr)-1]) {
+    switch (ctx->token.value) {
         case 's': {
-            token = next_tok();
-            if (token == TOK_STR_LIT) {
-                char * lptr = lexstr;
+            ctx->token = next_tok(ctx);
+            if (ctx->token.type == TOK_STR_LIT) {
+                const char * lptr = ctx->token.str;
+                const char * lend = ctx->token.str + ctx->token.len;
                 char letter;
 
-                DEBUG("  Reading string `%s'", lexstr);
+                TRACE_TEXT(TR_STRING, ctx->token.str, ctx->token.len,
+                           0, 0, 0, 0);
 
-                /* reallocate space for string */
-                instrCap = instrPtr + strlen(lexstr);
-                temp = (char *) realloc(instrBuffer, instrCap);
-                if (temp == NULL) {
-                    fprintf(stderr, "realloc() error.\n");
-                    exit(1);
-                }
-                instrBuffer = temp;
+                /* make space for string, escapes only shrink it */
+                if (emit_reserve(out, ctx->token.len))
+                    ERR_QUIT("Could not write data.");
 
-                while (*lptr != '\0') {
+                while (lptr < lend) {
                     letter = *lptr;
 
                     /* handle escaped characters */
-                    if (letter == '\\') {
-                        switch (*(++lptr)) {
-                            case '0': letter = '\0'; break;
-                            case 'n': letter = '\n'; break;
-                            case 't': letter = '\t'; break;
-                        }
-                    }
+                    if (letter == '\\')
+                        letter = lex_escape(*(++lptr));
 
                     /* save character into the buffer */
-                    instrBuffer[instrPtr++] = letter;
+                    out->buf[out->ptr++] = letter;
                     lptr++;
                 }
             } else {
-                jas_err("Expected string.", curr_line, lo_col, curr_col);
+                ERR_HERE("Expected string.");
             }
             break;
         }
@@ -423,40 +462,31 @@ static void readDataSegment(void) {
             /* read in list of numbers/char literals as 8-bit integers */
             int byte;
 
-            while ((token = next_tok()) != TOK_NL) {
+            while ((ctx->token = next_tok(ctx)).type != TOK_NL) {
                 /* 8-bit integer should come first */
-                if (token == TOK_NUM || token == TOK_CHR_LIT) {
+                if (ctx->token.type == TOK_NUM
+                        || ctx->token.type == TOK_CHR_LIT) {
 
                     /* read number, check range */
-                    byte = lexint;
+                    byte = ctx->token.value;
                     if (byte < SCHAR_MIN || SCHAR_MAX < byte)
-                        jas_err("Number too large to fit in 8-bits.",
-                                  curr_line, lo_col, curr_col);
-
+                        ERR_HERE("Number too large to fit in 8-bits.");
 
-                    /* reallocate space for byte */
-                    instrCap = instrPtr + 1;
-                    temp = (char *) realloc(instrBuffer, instrCap);
-                    if (temp == NULL) {
-                        fprintf(stderr, "realloc() error.\n");
-                        exit(1);
-                    }
-                    instrBuffer = temp;
 
                     /* write byte to buffer */
-                    instrBuffer[instrPtr++] = (signed char) byte;
+                    if (emit_u8(out, (signed char) byte))
+                        ERR_QUIT("Could not write data.");
 
                 } else {
-                    jas_err("Expected byte value.", curr_line,
-                            lo_col, curr_col);
+                    ERR_HERE("Expected byte value.");
                 }
 
                 /* comma or newline should follow */
-                token = next_tok();
-                if (token != TOK_COMMA && token != TOK_NL)
-                    jas_err("Expected `,'.", curr_line, lo_col, curr_col);
+                ctx->token = next_tok(ctx);
+                if (ctx->token.type != TOK_COMMA && ctx->token.type != TOK_NL)
+                    ERR_HERE("Expected `,'.");
 
-                if (token == TOK_NL) return; /* we're done, eol */
+                if (ctx->token.type == TOK_NL) return; /* we're done, eol */
             }
 
         }
@@ -465,42 +495,32 @@ static void readDataSegment(void) {
             /* read in the list of numbers as 32-bit integers */
             int word;
 
-            while ((token = next_tok()) != TOK_NL) {
+            while ((ctx->token = next_tok(ctx)).type != TOK_NL) {
                 /* 32-bit integer should come first */
-                if (token == TOK_NUM) {
+                if (ctx->token.type == TOK_NUM) {
 
                     /* read the word in */
-                    word = lexint;
-
-                    /* reallocate space for word */
-                    instrCap = instrPtr + sizeof(word);
-                    temp = (char *) realloc(instrBuffer, instrCap);
-                    if (temp == NULL) {
-                        fprintf(stderr, "realloc() error.\n");
-                        exit(1);
-                    }
-                    instrBuffer = temp;
+                    word = ctx->token.value;
 
                     /* write word to buffer */
-                    memcpy(instrBuffer + instrPtr, &word, sizeof(word));
-                    instrPtr += sizeof(word);
+                    if (emit_u32(out, word))
+                        ERR_QUIT("Could not write data.");
 
                 } else {
-                    jas_err("Expected number.", curr_line, lo_col, curr_col);
+                    ERR_HERE("Expected number.");
                 }
 
                 /* comma or newline should follow */
-                token = next_tok();
-                if (token != TOK_COMMA && token != TOK_NL)
-                    jas_err("Expected `,'.", curr_line, lo_col, curr_col);
+                ctx->token = next_tok(ctx);
+                if (ctx->token.type != TOK_COMMA && ctx->token.type != TOK_NL)
+                    ERR_HERE("Expected `,'.");
 
-                if (token == TOK_NL) return; /* we're done, eol */
+                if (ctx->token.type == TOK_NL) return; /* we're done, eol */
             }
         }
 
         default:
-            jas_err("Non-existent data segment type.", curr_line, lo_col,
-                      curr_col);
+            ERR_HERE("Non-existent data segment type.");
     }
 
 }
@@ -520,9 +540,3 @@ int isRegister(TokenType token) {
     return (token == TOK_GL_REG || token == TOK_GS_REG ||
             token == TOK_E_REG || token == TOK_K_REG);
 }
-
-static int isRegType(OperandType type) {
-    return type == OT_REG ||
-           type == OT_REG_ACCESS ||
-           type == OT_REG_OFFSET;
-}
@@ -3,16 +3,20 @@
 
 #include <stdio.h>
 
-#include "lexer.h"
+#include "Context.h"
+
+/* report an error at the current token */
+#define ERR_HERE(msg) \
+    jas_err(ctx, msg, ctx->token.line, ctx->token.lo, ctx->token.hi)
 
 #define ERR_QUIT(msg) \
-    do { jas_err(msg, curr_line, lo_col, curr_col); return; } while (0)
+    do { ERR_HERE(msg); return; } while (0)
 
 /* passed to strtol to read in any base */
 #define ANY_BASE 0
 
 /** function prototypes **/
-void assemble(FILE * in, FILE * out);
+void assemble(JasContext * ctx);
 int isRegister(TokenType);
 
 #endif
@@ -0,0 +1,158 @@
+#include "scan.h"
+
+#if !defined(JAS_NO_SIMD) && defined(__AVX2__)
+#  include <immintrin.h>
+#  define SCAN_AVX2
+#elif !defined(JAS_NO_SIMD) && defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SCAN_SSE2
+#endif
+
+/* shorthands for the table below */
+#define _ 0
+#define S CC_SPACE
+#define A (CC_IDSTART | CC_IDCONT)
+#define D (CC_IDCONT | CC_DIGIT)
+
+const unsigned char char_class[256] = {
+/*        0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f */
+/* 0x */  _, _, _, _, _, _, _, _, _, S, _, S, S, S, _, _,
+/* 1x */  _, _, _, _, _, _, _, _, _, _, _, _, _, _, _, _,
+/* 2x */  S, _, _, _, A, _, _, _, _, _, _, _, _, _, _, _,
+/* 3x */  D, D, D, D, D, D, D, D, D, D, _, _, _, _, _, _,
+/* 4x */  _, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+/* 5x */  A, A, A, A, A, A, A, A, A, A, A, _, _, _, _, A,
+/* 6x */  _, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+/* 7x */  A, A, A, A, A, A, A, A, A, A, A, _, _, _, _, _,
+    /* 0x80 and up are all zero */
+};
+
+#undef _
+#undef S
+#undef A
+#undef D
+
+/* first byte in [p, end) without the given class bits */
+static inline const char * scan_class(const char * p, const char * end,
+                                      unsigned char cls) {
+    while (p < end && (char_class[(unsigned char) *p] & cls))
+        p++;
+    return p;
+}
+
+/* ----------------------------- Vector Kernels ----------------------------- */
+
+/*
+ * Each kernel builds a mask with a set bit for every byte that ends the run,
+ * and stops at the lowest one. Unsigned range checks use the min trick:
+ * x <= n  <=>  min(x, n) == x.
+ */
+
+#if defined(SCAN_AVX2)
+
+#define VEC_WIDTH 32
+typedef __m256i vec;
+
+static inline vec vload(const char * p) {
+    return _mm256_loadu_si256((const __m256i *) p);
+}
+static inline vec vset(char c) { return _mm256_set1_epi8(c); }
+static inline vec veq(vec a, vec b) { return _mm256_cmpeq_epi8(a, b); }
+static inline vec vor(vec a, vec b) { return _mm256_or_si256(a, b); }
+static inline vec vandnot(vec a, vec b) { return _mm256_andnot_si256(a, b); }
+static inline vec vsub(vec a, vec b) { return _mm256_sub_epi8(a, b); }
+static inline vec vmin(vec a, vec b) { return _mm256_min_epu8(a, b); }
+static inline unsigned vmask(vec a) {
+    return (unsigned) _mm256_movemask_epi8(a);
+}
+
+#elif defined(SCAN_SSE2)
+
+#define VEC_WIDTH 16
+typedef __m128i vec;
+
+static inline vec vload(const char * p) {
+    return _mm_loadu_si128((const __m128i *) p);
+}
+static inline vec vset(char c) { return _mm_set1_epi8(c); }
+static inline vec veq(vec a, vec b) { return _mm_cmpeq_epi8(a, b); }
+static inline vec vor(vec a, vec b) { return _mm_or_si128(a, b); }
+static inline vec vandnot(vec a, vec b) { return _mm_andnot_si128(a, b); }
+static inline vec vsub(vec a, vec b) { return _mm_sub_epi8(a, b); }
+static inline vec vmin(vec a, vec b) { return _mm_min_epu8(a, b); }
+static inline unsigned vmask(vec a) {
+    return (unsigned) _mm_movemask_epi8(a) & 0xFFFF;
+}
+
+#endif
+
+#ifdef VEC_WIDTH
+
+/* x in [lo, lo + n] as unsigned bytes */
+static inline vec vrange(vec x, char lo, char n) {
+    vec d = vsub(x, vset(lo));
+    return veq(vmin(d, vset(n)), d);
+}
+
+/* bytes that are [ \t\v\f\r] */
+static inline vec vspace(vec x) {
+    vec ctl = vandnot(veq(x, vset('\n')), vrange(x, '\t', '\r' - '\t'));
+    return vor(ctl, veq(x, vset(' ')));
+}
+
+/* bytes that are [A-Za-z0-9$_] */
+static inline vec vident(vec x) {
+    vec alpha = vrange(vor(x, vset(0x20)), 'a', 'z' - 'a');
+    vec digit = vrange(x, '0', '9' - '0');
+    vec extra = vor(veq(x, vset('$')), veq(x, vset('_')));
+    return vor(vor(alpha, digit), extra);
+}
+
+#define ALL_ONES ((unsigned) ((1ULL << VEC_WIDTH) - 1))
+
+const char * scan_space(const char * p, const char * end) {
+    unsigned stop;
+    if (p < end && !(char_class[(unsigned char) *p] & CC_SPACE)) return p;
+    for (; end - p >= VEC_WIDTH; p += VEC_WIDTH) {
+        stop = ~vmask(vspace(vload(p))) & ALL_ONES;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return scan_class(p, end, CC_SPACE);
+}
+
+const char * scan_eol(const char * p, const char * end) {
+    unsigned stop;
+    for (; end - p >= VEC_WIDTH; p += VEC_WIDTH) {
+        stop = vmask(veq(vload(p), vset('\n')));
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+const char * scan_ident(const char * p, const char * end) {
+    unsigned stop;
+    if (p < end && !(char_class[(unsigned char) *p] & CC_IDCONT)) return p;
+    for (; end - p >= VEC_WIDTH; p += VEC_WIDTH) {
+        stop = ~vmask(vident(vload(p))) & ALL_ONES;
+        if (stop) return p + __builtin_ctz(stop);
+    }
+    return scan_class(p, end, CC_IDCONT);
+}
+
+#else /* scalar fallback */
+
+const char * scan_space(const char * p, const char * end) {
+    return scan_class(p, end, CC_SPACE);
+}
+
+const char * scan_eol(const char * p, const char * end) {
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+const char * scan_ident(const char * p, const char * end) {
+    return scan_class(p, end, CC_IDCONT);
+}
+
+#endif
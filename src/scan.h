@@ -0,0 +1,29 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+/*
+ * Character classification and bulk scanning for the lexer.
+ *
+ * Classes come from a 256-entry table (ASCII only, independent of locale).
+ * The scan_* functions skip a whole run of one class at a time, using SSE2 or
+ * AVX2 when the compiler targets them, and the table otherwise. Define
+ * JAS_NO_SIMD to force the table-only versions.
+ */
+
+/* character class bits */
+#define CC_SPACE   0x01 /* whitespace other than '\n': [ \t\v\f\r] */
+#define CC_IDSTART 0x02 /* [A-Za-z$_]                              */
+#define CC_IDCONT  0x04 /* [A-Za-z0-9$_]                           */
+#define CC_DIGIT   0x08 /* [0-9]                                   */
+
+extern const unsigned char char_class[256];
+
+#define CC_IS(c, cls) ((c) >= 0 && (char_class[(c)] & (cls)))
+
+/** function prototypes **/
+/* each returns the first byte in [p, end) not in the run, or `end` */
+const char * scan_space(const char * p, const char * end);
+const char * scan_eol(const char * p, const char * end);
+const char * scan_ident(const char * p, const char * end);
+
+#endif